@@ -1,15 +1,23 @@
 //#define _CRT_SECURE_NO_WARNINGS
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 #include <locale.h>
 #include <stdbool.h>
 #include <limits.h>
 #include <math.h>
 #include <time.h>
+#ifndef NO_THREADS
+#include <threads.h>
+#include <stdatomic.h>
+#endif
 #include <glew.h>
 #include <glfw3.h>
 #include <string.h>
 #include <ctype.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #define C 1.41 //    
 #define WINDOW_WIDTH 800
@@ -20,18 +28,77 @@
 #define MAX_SIZE 100
 #define MIN_SIZE 3
 #define MAX_WIN_LINE 100
-
-// 
+#define LINE_WORDS 2 // 128     ,   MAX_SIZE
+#define TILE_SHIFT 4
+#define COORD_LIMIT (LLONG_MAX / 4) //    ,      
+#define TILE_SIZE (1 << TILE_SHIFT)
+#define ASPIRATION_WINDOW 1000 //         PVS
+#define QUIESCE_DEPTH 4 //       , 6  ,  
+#define LMR_FULL_MOVES 4 //         
+#define NULL_MOVE_R 2 //       
+#define MAX_PLY 64 //  ,    -
+#define SPLIT_MIN_DEPTH 3 //       ,   ,  
+#define ROOT_BATCH 4 //    :   -    ,     
+#define ROOT_WAIT -2 // root_take:    ,    
+#define HISTORY_SIZE 128 //   ,    
+#define THREAT_CACHE_SIZE (1 << 16) //     ,  
+#define VCF_DEPTH 12 //       
+#define VCT_DEPTH 4 //       ,    
+#define THREAT_NODES 20000 //      
+#define FILTER_NODES THREAT_NODES //        ,     
+#define PREP_SHARE 2 //        1/PREP_SHARE  
+#define AI_QUEUE_SIZE 4 //    ,   
+#define COOP_SLICE_MS 10 //      ,    16    
+#define PATTERN_MAX_LEN 6 //        (3^12 ),  -   
+#ifndef AI_DEBUG
+#define AI_DEBUG 0 // 1 -       (  -DAI_DEBUG=1)
+#endif
+//   -DNO_THREADS   <threads.h>  <stdatomic.h>:         
+
+//   (   )
 typedef struct Node {
     long long x, y;
     char value;
-    struct Node* next;
 } Node;
 
-// -
+//  - :         
+typedef struct {
+    long long tx, ty;
+    int tile; //   + 1, 0 -  
+} Slot;
+
+//   16x16    
+typedef struct {
+    long long tx, ty;
+    char cells[TILE_SIZE * TILE_SIZE];     //  (y & 15) * 16 + (x & 15)
+    unsigned short occupied[TILE_SIZE];    //      
+    unsigned short run_lo[4][TILE_SIZE * TILE_SIZE]; //        ,    
+    unsigned short run_hi[4][TILE_SIZE * TILE_SIZE]; //  
+    int count;
+} Tile;
+
+//    :    ,    
 typedef struct {
-    Node** buckets;
-    unsigned long long capacity;
+    unsigned long long rows[2][MAX_SIZE][LINE_WORDS];          //  y,  x
+    unsigned long long cols[2][MAX_SIZE][LINE_WORDS];          //  x,  y
+    unsigned long long diag[2][2 * MAX_SIZE - 1][LINE_WORDS];  // x - y = const,  y
+    unsigned long long anti[2][2 * MAX_SIZE - 1][LINE_WORDS];  // x + y = const,  y
+} Bitboard;
+
+// :  16x16,      -
+//   ,   ,       MAX_SIZE
+typedef struct {
+    Slot* slots;
+    unsigned long long capacity; //   
+    unsigned long long count;    //  
+    unsigned long long zobrist;  //  ,   insert  remove_cell
+    Tile* tiles;
+    int tile_count, tile_capacity;
+    int last_tile;               //   ,      
+    bool use_bits;
+    bool infinite;
+    unsigned long long size;
+    Bitboard bits;
 } Table;
 
 //  
@@ -47,6 +114,15 @@ typedef struct {
     short difficulty; // 1: easy, 2: middle, 3: hard, 4: impossible
     bool player_moves_first;
     int infinite_field;
+    unsigned int tt_mb; //     
+    unsigned int time_budget_ms; //      , 0 -     
+    int search_mode; // MINIMAX  PVS  algorithms
+    bool use_lmr;       //        
+    bool use_null_move; //      
+    int search_threads; //  , 1 -  
+    int parallel_mode;  // ROOT_SPLIT, LAZY_SMP  YBWC  parallel_modes
+    bool ponder;        //   ,       
+    bool cooperative;   //       ,  
 } base;
 
 //      
@@ -55,6 +131,33 @@ typedef struct {
     bool initialized;
 } bounds;
 
+//    : ,       5x5  
+typedef struct {
+    long long x, y;
+    int near;   //     5x5  
+    int index;  //    , -1     near == 0
+    bool stone; //    
+    bool used;  //  - 
+} CandSlot;
+
+//  :     2  ,   make_move  unmake_move
+typedef struct {
+    CandSlot* slots;
+    unsigned long long capacity; //   
+    unsigned long long used;
+    int* list; //   
+    int n;
+} CandSet;
+
+//   : ,         
+typedef struct {
+    long long x, y;
+    char value;
+    bounds bbox;
+    long long last_ai_x, last_ai_y;
+    long long last_pl_x, last_pl_y;
+} UndoEntry;
+
 //   
 typedef enum {
     MENU_SCREEN,
@@ -74,17 +177,106 @@ typedef struct {
     bool is_mouse;
 } Button;
 
+//     
+typedef enum {
+    TT_EXACT,
+    TT_LOWER, //     
+    TT_UPPER  //     
+} tt_bound;
+
+//   
+typedef struct {
+    unsigned long long key;
+    int score;
+    short depth;
+    unsigned char bound;
+    unsigned char generation;
+    bool has_move;
+    long long best_x, best_y;
+} TTEntry;
+
+//   :       ,     
+#ifndef NO_THREADS
+typedef _Atomic unsigned long long tt_word;
+#define tt_word_load(w) atomic_load_explicit(&(w), memory_order_relaxed)
+#define tt_word_store(w, v) atomic_store_explicit(&(w), (v), memory_order_relaxed)
+#else
+typedef unsigned long long tt_word;
+#define tt_word_load(w) (w)
+#define tt_word_store(w, v) ((w) = (v))
+#endif
+
+/*   :       ,  
+check = key ^ data ^ x ^ y,  ,      ,   */
+typedef struct {
+    tt_word check;
+    tt_word data; // score, depth, bound  has_move, generation
+    tt_word x, y; //  
+} TTSlot;
+
+// :      ,  
+typedef struct {
+    TTSlot deep;
+    TTSlot recent;
+} TTBucket;
+
+//  ,   -  
+typedef struct {
+    TTBucket* buckets;
+    unsigned long long mask;
+    unsigned int mb;
+    unsigned char generation; //   ,    
+} TransTable;
+
+//    :        
+typedef struct {
+    unsigned long long key;
+    short depth;   // won:    depth  ,  -  depth  
+    bool won;
+    long long move_x, move_y; //    
+} ThreatEntry;
+
 //  
 typedef struct {
     ScreenState current_screen;
     Table* board;
+    TransTable* tt;
+    TransTable tt_part; //   ,       
     base parameters;
     bounds bbox;
+    UndoEntry* undo; //    ,  
+    int undo_top;
+    int undo_capacity;
+    int threats[2][MAX_WIN_LINE + 1]; // [][k]:   len,  k     
+    int* patterns;    //       len, NULL  len > PATTERN_MAX_LEN
+    int pattern_len;
+    CandSet cands;
+    ThreatEntry* threat_cache;        // THREAT_CACHE_SIZE ,   
+    unsigned long long threat_nodes;  //     
+    unsigned long long threat_limit;  //    
+    long long threat_pause;           //   now_ms,   , 0 -  
+    bool threat_paused;
+    long long killer_x[MAX_PLY][2], killer_y[MAX_PLY][2]; // ,     ply, LLONG_MAX - 
+    int history[2][HISTORY_SIZE][HISTORY_SIZE];          // [][y][x]:    
+    long long history_x0, history_y0;                   // ,     
+    long long search_deadline; //   now_ms,    , 0 -  
+    bool search_abort;         //  ,     
+    unsigned long long search_nodes;
+    short search_depth;        //    
+    bool null_move;            //     ,      
+#ifndef NO_THREADS
+    struct SearchPool* pool;   //  , NULL -    
+    atomic_bool* stop;         //   :     
+    struct SplitPoint* split;  //    YBWC,    , NULL - 
+    int slot;                  //    : 0 - , i + 1 - workers[i]
+    struct AIWorker* ai;       //   , NULL -       
+#endif
+    struct CoopSearch* coop;   //     , NULL -  
     float char_width;
     float char_height;
     float char_spacing;
-    int view_offset_x;
-    int view_offset_y;
+    long long view_offset_x; //   ,     
+    long long view_offset_y;
     long long cursor_x, cursor_y;
     bool is_player_turn;
     Button help_button;
@@ -105,27 +297,198 @@ typedef struct {
 //  
 typedef enum {
     MINIMAX,
-    MCTS
+    MCTS,
+    PVS //            
 } algorithms;
 
-//    
+//    
+typedef enum {
+    ROOT_SPLIT, //     
+    LAZY_SMP,   //     ,     
+    YBWC        //         
+} parallel_modes;
+
+//     (capacity -  )
 unsigned long long hash_mix64(long long x, long long y, unsigned long long capacity) {
     unsigned long long z = (unsigned long long)x;
     z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
     z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
     z = z ^ ((unsigned long long)y ^ ((unsigned long long)y >> 30));
     z += 0x9e3779b97f4a7c15ULL;
-    return z % capacity;
+    return z & (capacity - 1);
+}
+
+//        
+int side_index(char value) {
+    return value == 'X' ? 0 : 1;
+}
+
+//     value   (x, y):    ,
+//   ,      
+unsigned long long zobrist_cell(long long x, long long y, char value) {
+    unsigned long long z = (unsigned long long)x * 0x9e3779b97f4a7c15ULL;
+    z ^= ((unsigned long long)y + 0x632be59bd9b4e019ULL) * 0xc2b2ae3d27d4eb4fULL;
+    z ^= side_index(value) ? 0xd6e8feb86659fd93ULL : 0x8cb92ba72f3d8dd7ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
 }
 
 //  
 Table* create_table(unsigned long long cap) {
+    unsigned long long pow2 = 16;
+    while (pow2 < cap) pow2 <<= 1;
     Table* t = (Table*)malloc(sizeof(Table));
-    t->buckets = (Node**)calloc(cap, sizeof(Node*));
-    t->capacity = cap;
+    t->slots = (Slot*)calloc(pow2, sizeof(Slot));
+    t->capacity = pow2;
+    t->count = 0;
+    t->zobrist = 0;
+    t->tile_capacity = 64;
+    t->tiles = (Tile*)malloc(t->tile_capacity * sizeof(Tile));
+    t->tile_count = 0;
+    t->last_tile = -1;
+    t->use_bits = false;
+    t->infinite = true;
+    t->size = 0;
     return t;
 }
 
+//     
+void clear_table(Table* board) {
+    memset(board->slots, 0, board->capacity * sizeof(Slot));
+    if (board->use_bits) memset(&board->bits, 0, sizeof(Bitboard));
+    board->count = 0;
+    board->zobrist = 0;
+    board->tile_count = 0;
+    board->last_tile = -1;
+}
+
+//      
+void setup_table(Table* board, base* parameters) {
+    board->use_bits = parameters->infinite_field == 0 && parameters->size <= MAX_SIZE;
+    board->infinite = parameters->infinite_field == 1;
+    board->size = parameters->size;
+    clear_table(board);
+}
+
+
+int ctz64(unsigned long long v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return (int)i;
+#elif defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    int n = 0;
+    while (!(v & 1)) { v >>= 1; n++; }
+    return n;
+#endif
+}
+
+int clz64(unsigned long long v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return 63 - (int)i;
+#elif defined(__GNUC__)
+    return __builtin_clzll(v);
+#else
+    int n = 0;
+    while (!(v & 0x8000000000000000ULL)) { v <<= 1; n++; }
+    return n;
+#endif
+}
+
+//   ,   (x, y)   dir,     
+unsigned long long* bits_line(Bitboard* bits, int side, int dir, long long x, long long y, int* pos) {
+    switch (dir) {
+    case 0: *pos = (int)x; return bits->rows[side][y];
+    case 1: *pos = (int)y; return bits->cols[side][x];
+    case 2: *pos = (int)y; return bits->diag[side][x - y + MAX_SIZE - 1];
+    default: *pos = (int)y; return bits->anti[side][x + y];
+    }
+}
+
+//     side
+bool bits_has(Bitboard* bits, int side, long long x, long long y) {
+    return (bits->rows[side][y][x >> 6] >> (x & 63)) & 1;
+}
+
+//        p 
+int bits_run_up(const unsigned long long* line, int p) {
+    int run = 0;
+    while (p < 64 * LINE_WORDS) {
+        int avail = 64 - (p & 63);
+        unsigned long long zeros = ~(line[p >> 6] >> (p & 63));
+        int r = zeros ? ctz64(zeros) : 64;
+        if (r > avail) r = avail;
+        run += r;
+        if (r < avail) break;
+        p += r;
+    }
+    return run;
+}
+
+//        p 
+int bits_run_down(const unsigned long long* line, int p) {
+    int run = 0;
+    while (p >= 0) {
+        int avail = (p & 63) + 1;
+        unsigned long long zeros = ~(line[p >> 6] << (63 - (p & 63)));
+        int r = zeros ? clz64(zeros) : 64;
+        if (r > avail) r = avail;
+        run += r;
+        if (r < avail) break;
+        p -= r;
+    }
+    return run;
+}
+
+//        
+void bits_put(Bitboard* bits, int side, long long x, long long y, bool on) {
+    for (int dir = 0; dir < 4; ++dir) {
+        int p;
+        unsigned long long* line = bits_line(bits, side, dir, x, y, &p);
+        if (on) line[p >> 6] |= 1ULL << (p & 63);
+        else line[p >> 6] &= ~(1ULL << (p & 63));
+    }
+}
+
+void free_table(Table* board) {
+    free(board->slots);
+    free(board->tiles);
+    free(board);
+}
+
+//   src  dst,  dst 
+void copy_table(Table* dst, Table* src) {
+    if (dst->capacity != src->capacity) {
+        free(dst->slots);
+        dst->slots = (Slot*)malloc(src->capacity * sizeof(Slot));
+    }
+    if (dst->tile_capacity < src->tile_count) {
+        free(dst->tiles);
+        dst->tiles = (Tile*)malloc(src->tile_capacity * sizeof(Tile));
+        dst->tile_capacity = src->tile_capacity;
+    }
+    if (!dst->slots || !dst->tiles) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+    memcpy(dst->slots, src->slots, src->capacity * sizeof(Slot));
+    memcpy(dst->tiles, src->tiles, src->tile_count * sizeof(Tile));
+    dst->capacity = src->capacity;
+    dst->count = src->count;
+    dst->zobrist = src->zobrist;
+    dst->tile_count = src->tile_count;
+    dst->last_tile = -1;
+    dst->use_bits = src->use_bits;
+    dst->infinite = src->infinite;
+    dst->size = src->size;
+    if (src->use_bits) dst->bits = src->bits;
+}
+
 //   
 bool reset_saved_game() {
     FILE* file = fopen("save.dat", "rb");
@@ -139,82 +502,411 @@ bool reset_saved_game() {
     return false; //       
 }
 
-//       (  )
-void insert(Table* board, long long x, long long y, char value) {
-    if (x >= MAX_SIZE || y >= MAX_SIZE) return; //   
-    unsigned long long index = hash_mix64(x, y, board->capacity);
-    Node* newNode = (Node*)malloc(sizeof(Node));
-    if (!newNode) return;
+//    (    ,     )
+void grow_table(Table* board) {
+    Slot* old = board->slots;
+    unsigned long long old_cap = board->capacity;
+    board->capacity = old_cap * 2;
+    board->slots = (Slot*)calloc(board->capacity, sizeof(Slot));
+    for (unsigned long long i = 0; i < old_cap; ++i) {
+        if (!old[i].tile) continue;
+        unsigned long long j = hash_mix64(old[i].tx, old[i].ty, board->capacity);
+        while (board->slots[j].tile) j = (j + 1) & (board->capacity - 1);
+        board->slots[j] = old[i];
+    }
+    free(old);
+}
+
+//     , -1   
+int find_tile(Table* board, long long tx, long long ty) {
+    if (board->last_tile >= 0) {
+        Tile* t = &board->tiles[board->last_tile];
+        if (t->tx == tx && t->ty == ty) return board->last_tile;
+    }
+    unsigned long long mask = board->capacity - 1;
+    unsigned long long i = hash_mix64(tx, ty, board->capacity);
+    while (board->slots[i].tile) {
+        if (board->slots[i].tx == tx && board->slots[i].ty == ty) {
+            board->last_tile = board->slots[i].tile - 1;
+            return board->last_tile;
+        }
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+//     
+int get_tile(Table* board, long long tx, long long ty) {
+    int found = find_tile(board, tx, ty);
+    if (found >= 0) return found;
+    if ((unsigned long long)(board->tile_count + 1) * 2 > board->capacity) grow_table(board);
+    if (board->tile_count == board->tile_capacity) {
+        board->tile_capacity *= 2;
+        board->tiles = (Tile*)realloc(board->tiles, board->tile_capacity * sizeof(Tile));
+    }
+    int index = board->tile_count++;
+    Tile* t = &board->tiles[index];
+    t->tx = tx;
+    t->ty = ty;
+    memset(t->cells, '.', sizeof(t->cells));
+    memset(t->occupied, 0, sizeof(t->occupied));
+    t->count = 0;
+
+    unsigned long long mask = board->capacity - 1;
+    unsigned long long i = hash_mix64(tx, ty, board->capacity);
+    while (board->slots[i].tile) i = (i + 1) & mask;
+    board->slots[i].tx = tx;
+    board->slots[i].ty = ty;
+    board->slots[i].tile = index + 1;
+    board->last_tile = index;
+    return index;
+}
 
-    newNode->x = x;
-    newNode->y = y;
-    newNode->value = value;
-    newNode->next = board->buckets[index];
-    board->buckets[index] = newNode;
+//  : , , , 
+const short LINE_DIRS[4][2] = { {1,0},{0,1},{1,1},{1,-1} };
+
+//    (x, y)     , NULL   
+Tile* cell_tile(Table* board, long long x, long long y, int* cell) {
+    int index = find_tile(board, x >> TILE_SHIFT, y >> TILE_SHIFT);
+    if (index < 0) return NULL;
+    *cell = (int)((y & (TILE_SIZE - 1)) * TILE_SIZE + (x & (TILE_SIZE - 1)));
+    return &board->tiles[index];
+}
+
+//   s    (x, y)   d  (step = 1)   (step = -1)
+//   -   ,  (x, y)    
+int run_beside(Table* board, long long x, long long y, int d, int step, char s) {
+    int cell;
+    Tile* t = cell_tile(board, x + step * LINE_DIRS[d][0], y + step * LINE_DIRS[d][1], &cell);
+    if (!t || t->cells[cell] != s) return 0;
+    return (step > 0 ? t->run_hi[d][cell] : t->run_lo[d][cell]) + 1;
+}
+
+/*       (x, y):       ,
+          */
+void run_place(Table* board, long long x, long long y, char s) {
+    int cell = 0;
+    for (int d = 0; d < 4; ++d) {
+        long long dx = LINE_DIRS[d][0], dy = LINE_DIRS[d][1];
+        int lo = run_beside(board, x, y, d, -1, s);
+        int hi = run_beside(board, x, y, d, 1, s);
+        Tile* t = cell_tile(board, x - lo * dx, y - lo * dy, &cell);
+        t->run_hi[d][cell] = (unsigned short)(lo + hi);
+        t = cell_tile(board, x + hi * dx, y + hi * dy, &cell);
+        t->run_lo[d][cell] = (unsigned short)(lo + hi);
+        t = cell_tile(board, x, y, &cell);
+        t->run_lo[d][cell] = (unsigned short)lo;
+        t->run_hi[d][cell] = (unsigned short)hi;
+    }
+}
+
+/*  run_place:   (x, y)    
+    ,   (  ),  
+   ,    */
+void run_lift(Table* board, long long x, long long y) {
+    int cell = 0;
+    Tile* c = cell_tile(board, x, y, &cell);
+    for (int d = 0; d < 4; ++d) {
+        long long dx = LINE_DIRS[d][0], dy = LINE_DIRS[d][1];
+        int lo = c->run_lo[d][cell], hi = c->run_hi[d][cell];
+        int end = 0;
+        Tile* t;
+        if (lo > 0) {
+            t = cell_tile(board, x - lo * dx, y - lo * dy, &end);
+            t->run_hi[d][end] = (unsigned short)(lo - 1);
+            t = cell_tile(board, x - dx, y - dy, &end);
+            t->run_lo[d][end] = (unsigned short)(lo - 1);
+        }
+        if (hi > 0) {
+            t = cell_tile(board, x + hi * dx, y + hi * dy, &end);
+            t->run_lo[d][end] = (unsigned short)(hi - 1);
+            t = cell_tile(board, x + dx, y + dy, &end);
+            t->run_hi[d][end] = (unsigned short)(hi - 1);
+        }
+    }
+}
+
+/*      (    )
+     :    make_move/unmake_move,   
+(run_place/run_lift) ,      .    */
+void insert(Table* board, long long x, long long y, char value) {
+    if (!board->infinite && (x < 0 || y < 0 || x >= (long long)board->size || y >= (long long)board->size)) return; //  
+    if (board->use_bits) {
+        int side = side_index(value);
+        bool taken = bits_has(&board->bits, side, x, y) || bits_has(&board->bits, 1 - side, x, y);
+        assert(!taken || bits_has(&board->bits, side, x, y));
+        if (taken) return;
+        board->count++;
+        bits_put(&board->bits, side, x, y, true);
+        board->zobrist ^= zobrist_cell(x, y, value);
+        return;
+    }
+    int index = get_tile(board, x >> TILE_SHIFT, y >> TILE_SHIFT);
+    Tile* t = &board->tiles[index];
+    int lx = (int)(x & (TILE_SIZE - 1)), ly = (int)(y & (TILE_SIZE - 1));
+    char old = t->cells[ly * TILE_SIZE + lx];
+    assert(old == '.' || old == value);
+    if (old != '.') return;
+    t->occupied[ly] |= (unsigned short)(1u << lx);
+    t->count++;
+    board->count++;
+    t->cells[ly * TILE_SIZE + lx] = value;
+    board->zobrist ^= zobrist_cell(x, y, value);
+    run_place(board, x, y, value);
 }
 
-//       (  )
+//      ,      
 void remove_cell(Table* board, long long x, long long y) {
-    unsigned long long index = hash_mix64(x, y, board->capacity);
-    Node* current = board->buckets[index];
-    Node* prev = NULL;
-    while (current != NULL) {
-        if (current->x == x && current->y == y) {
-            if (prev == NULL) board->buckets[index] = current->next;
-            else prev->next = current->next;
-            free(current);
-            return;
+    if (board->use_bits) {
+        if (x < 0 || y < 0 || x >= (long long)board->size || y >= (long long)board->size) return;
+        for (int side = 0; side < 2; ++side) {
+            if (bits_has(&board->bits, side, x, y)) {
+                bits_put(&board->bits, side, x, y, false);
+                board->zobrist ^= zobrist_cell(x, y, side ? 'O' : 'X');
+                board->count--;
+            }
         }
-        prev = current;
-        current = current->next;
+        return;
     }
+    int index = find_tile(board, x >> TILE_SHIFT, y >> TILE_SHIFT);
+    if (index < 0) return;
+    Tile* t = &board->tiles[index];
+    int lx = (int)(x & (TILE_SIZE - 1)), ly = (int)(y & (TILE_SIZE - 1));
+    char old = t->cells[ly * TILE_SIZE + lx];
+    if (old == '.') return;
+    run_lift(board, x, y);
+    board->zobrist ^= zobrist_cell(x, y, old);
+    t->cells[ly * TILE_SIZE + lx] = '.';
+    t->occupied[ly] &= (unsigned short)~(1u << lx);
+    t->count--;
+    board->count--;
 }
 
 char get_value(Table* board, long long x, long long y, unsigned long long size, GameContext* ctx) {
     if ((x >= size || y >= size) && ctx->parameters.infinite_field == 0) return '\0';
-    unsigned long long index = hash_mix64(x, y, board->capacity);
-    Node* current = board->buckets[index];
-    while (current != NULL) {
-        if (current->x == x && current->y == y) return current->value;
-        current = current->next;
+    if (board->use_bits) {
+        if (bits_has(&board->bits, 0, x, y)) return 'X';
+        if (bits_has(&board->bits, 1, x, y)) return 'O';
+        return '.';
+    }
+    int index = find_tile(board, x >> TILE_SHIFT, y >> TILE_SHIFT);
+    if (index < 0) return '.';
+    return board->tiles[index].cells[(y & (TILE_SIZE - 1)) * TILE_SIZE + (x & (TILE_SIZE - 1))];
+}
+
+//    , it = 0  
+bool table_next(Table* board, unsigned long long* it, Node* out) {
+    if (board->use_bits) {
+        for (; *it < board->size * board->size; ++*it) {
+            long long x = (long long)(*it % board->size), y = (long long)(*it / board->size);
+            for (int side = 0; side < 2; ++side) {
+                if (bits_has(&board->bits, side, x, y)) {
+                    out->x = x;
+                    out->y = y;
+                    out->value = side ? 'O' : 'X';
+                    ++*it;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    // it =   * 256 +    
+    for (; *it < (unsigned long long)board->tile_count * TILE_SIZE * TILE_SIZE; ++*it) {
+        Tile* t = &board->tiles[*it / (TILE_SIZE * TILE_SIZE)];
+        int cell = (int)(*it % (TILE_SIZE * TILE_SIZE));
+        if (!t->count) {
+            *it += TILE_SIZE * TILE_SIZE - cell - 1;
+            continue;
+        }
+        if (t->cells[cell] == '.') continue;
+        out->x = t->tx * TILE_SIZE + cell % TILE_SIZE;
+        out->y = t->ty * TILE_SIZE + cell / TILE_SIZE;
+        out->value = t->cells[cell];
+        ++*it;
+        return true;
     }
-    return '.';
+    return false;
+}
+
+//   s  (x, y)   d  ,   len   
+unsigned long long scan_run(Table* board, unsigned long long size, unsigned long long len,
+    long long x, long long y, int d, char s, GameContext* ctx) {
+    int dx = LINE_DIRS[d][0], dy = LINE_DIRS[d][1];
+    unsigned long long count = 1;
+
+    //    
+    for (int k = 1; k < len; ++k) {
+        char val = get_value(board, x + dx * k, y + dy * k, size, ctx);
+        if (val != s) break;
+        count++;
+    }
+
+    //    
+    for (int k = 1; k < len; ++k) {
+        char val = get_value(board, x - dx * k, y - dy * k, size, ctx);
+        if (val != s) break;
+        count++;
+    }
+    return count;
 }
 
+//     len  s  (x, y);    -      
 bool check_win(Table* board, unsigned long long size, unsigned long long len,
     long long x, long long y, char s, GameContext* ctx) {
-    short D[4][2] = { {1,0},{0,1},{1,1},{1,-1} };
+    if (board->use_bits) {
+        //   (x, y)      
+        if (x < 0 || y < 0 || x >= (long long)board->size || y >= (long long)board->size) return false;
+        int side = side_index(s);
+        for (int dir = 0; dir < 4; ++dir) {
+            int p;
+            unsigned long long* line = bits_line(&board->bits, side, dir, x, y, &p);
+            unsigned long long count = 1 + bits_run_up(line, p + 1) + bits_run_down(line, p - 1);
+            if (count >= len) return true;
+        }
+        return false;
+    }
 
+    //     ,   insert  remove_cell
+    int cell = 0;
+    Tile* t = cell_tile(board, x, y, &cell);
+    bool placed = t && t->cells[cell] == s;
     for (int d = 0; d < 4; ++d) {
-        int dx = D[d][0], dy = D[d][1];
-        unsigned long long count = 1;
-
-        //    
-        for (int k = 1; k < len; ++k) {
-            char val = get_value(board, x + dx * k, y + dy * k, size, ctx);
-            if (val != s) break;
-            count++;
+        long long dx = LINE_DIRS[d][0], dy = LINE_DIRS[d][1];
+        unsigned long long count;
+        if (!placed) {
+            //  :   -   
+            count = 1 + run_beside(board, x, y, d, -1, s) + run_beside(board, x, y, d, 1, s);
         }
-
-        //    
-        for (int k = 1; k < len; ++k) {
-            char val = get_value(board, x - dx * k, y - dy * k, size, ctx);
-            if (val != s) break;
-            count++;
+        else {
+            int lo = t->run_lo[d][cell], hi = t->run_hi[d][cell];
+            if (run_beside(board, x - lo * dx, y - lo * dy, d, -1, s) ||
+                run_beside(board, x + hi * dx, y + hi * dy, d, 1, s)) {
+                //     ,      
+                count = scan_run(board, size, len, x, y, d, s, ctx);
+            }
+            else count = 1 + lo + hi;
         }
-
         if (count >= len) return true;
     }
 
     return false;
 }
 
+//  
+#define SHAPE_FIVE 1000000
+#define SHAPE_OPEN_FOUR 100000
+#define SHAPE_FOUR 10000
+#define SHAPE_OPEN_THREE 5000
+
+/*       len    center
+line: 0 - , 1 - , 2 -    ;    center
+ -1,    */
+int completion_spots(const char* line, int n, int len, int center) {
+    bool spot[2 * PATTERN_MAX_LEN + 1] = { false };
+    int spots = 0;
+    for (int a = center - len + 1; a <= center; ++a) {
+        if (a < 0 || a + len > n) continue;
+        int own = 0, empty = -1;
+        bool dead = false;
+        for (int k = a; k < a + len; ++k) {
+            if (line[k] == 2) dead = true;
+            else if (line[k] == 1) own++;
+            else empty = k;
+        }
+        if (dead) continue;
+        if (own == len) return -1;
+        if (own == len - 1 && !spot[empty]) {
+            spot[empty] = true;
+            spots++;
+        }
+    }
+    return spots;
+}
+
+//    2 * len + 1  ,      
+int shape_value(char* line, int len) {
+    int n = 2 * len + 1, center = len;
+    line[center] = 1;
+    int spots = completion_spots(line, n, len, center);
+    if (spots < 0) return SHAPE_FIVE;
+    if (spots >= 2) return SHAPE_OPEN_FOUR;
+    if (spots == 1) return SHAPE_FOUR;
+    //  :        
+    for (int e = 0; e < n; ++e) {
+        if (line[e] != 0) continue;
+        line[e] = 1;
+        int next = completion_spots(line, n, len, center);
+        line[e] = 0;
+        if (next >= 2 || next < 0) return SHAPE_OPEN_THREE;
+    }
+    //  -        
+    int best = 0, windows = 0;
+    for (int a = 0; a <= center; ++a) {
+        if (a + len > n) continue;
+        int own = 0;
+        bool dead = false;
+        for (int k = a; k < a + len; ++k) {
+            if (line[k] == 2) dead = true;
+            else if (line[k] == 1) own++;
+        }
+        if (dead) continue;
+        windows++;
+        if (own > best) best = own;
+    }
+    return best * best * 10 + windows;
+}
+
+/*      :   -    ,
+ -     -len..-1, 1..len (0 - , 1 - , 2 -   )
+   ,    */
+void setup_patterns(GameContext* ctx) {
+    int len = (int)ctx->parameters.len;
+    if (ctx->patterns && ctx->pattern_len == len) return;
+    free(ctx->patterns);
+    ctx->patterns = NULL;
+    ctx->pattern_len = 0;
+    if (len > PATTERN_MAX_LEN) return;
+    int codes = 1;
+    for (int i = 0; i < 2 * len; ++i) codes *= 3;
+    ctx->patterns = (int*)malloc(codes * sizeof(int));
+    if (!ctx->patterns) return;
+    char line[2 * PATTERN_MAX_LEN + 1];
+    for (int code = 0; code < codes; ++code) {
+        int c = code;
+        for (int i = 0; i < 2 * len; ++i) {
+            line[i < len ? i : i + 1] = (char)(c % 3);
+            c /= 3;
+        }
+        ctx->patterns[code] = shape_value(line, len);
+    }
+    ctx->pattern_len = len;
+}
+
 //   
 int line_score(Table* board, unsigned long long size, unsigned long long len,
     long long x, long long y, char s, GameContext* ctx) {
 
     if (get_value(board, x, y, size, ctx) != '.') return INT_MIN / 4;
 
+    if (ctx->patterns) {
+        //     ,  -    
+        int sum = 0;
+        for (int d = 0; d < 4; ++d) {
+            int code = 0, power = 1;
+            for (long long k = -(long long)len; k <= (long long)len; ++k) {
+                if (!k) continue;
+                char val = get_value(board, x + k * LINE_DIRS[d][0], y + k * LINE_DIRS[d][1], size, ctx);
+                if (val != '.') code += power * (val == s ? 1 : 2);
+                power *= 3;
+            }
+            int v = ctx->patterns[code];
+            if (v >= SHAPE_FIVE) return 1000000;
+            sum += v;
+        }
+        return sum;
+    }
+
     int sum = 0;
     short D[4][2] = { {1,0},{0,1},{1,1},{1,-1} };
 
@@ -259,25 +951,97 @@ int line_score(Table* board, unsigned long long size, unsigned long long len,
 }
 
 
-//         (  )
-int eval_heuristic(Table* board, base* parameters, bounds* bbox, GameContext* ctx) {
-    int best_ai = 0, best_pl = 0;
-    short R = 2;
-    if (!bbox->initialized) return 0;
-    long long x0 = bbox->minx - R;
-    long long x1 = bbox->maxx + R;
-    long long y0 = bbox->miny - R;
-    long long y1 = bbox->maxy + R;
-    for (long long y = y0; y <= y1; ++y) {
-        for (long long x = x0; x <= x1; ++x) {
-            if (get_value(board, x, y, parameters->size, ctx) != '.') continue;
-            int score_ai = line_score(board, parameters->size, parameters->len, x, y, parameters->ai, ctx);
-            int score_pl = line_score(board, parameters->size, parameters->len, x, y, parameters->player, ctx);
-            if (score_ai > best_ai) best_ai = score_ai;
-            if (score_pl > best_pl) best_pl = score_pl;
+/*  d  (x, y): vals[k + len - 1] -    k, |k| < len
+    get_value  '\0'*/
+void axis_cells(GameContext* ctx, long long x, long long y, int d, char* vals) {
+    long long len = (long long)ctx->parameters.len;
+    for (long long k = 1 - len; k < len; ++k) {
+        vals[k + len - 1] = get_value(ctx->board, x + k * LINE_DIRS[d][0], y + k * LINE_DIRS[d][1], ctx->parameters.size, ctx);
+    }
+}
+
+//    cx   co    
+void threat_count(GameContext* ctx, int cx, int co, int delta) {
+    if (co == 0 && cx > 0) ctx->threats[0][cx] += delta;
+    if (cx == 0 && co > 0) ctx->threats[1][co] += delta;
+}
+
+/*     (delta = 1)   (delta = -1)   (x, y)
+    ;   len       
+    2 * len - 1 ,     */
+void threat_update(GameContext* ctx, long long x, long long y, char value, int delta) {
+    int len = (int)ctx->parameters.len;
+    int side = side_index(value);
+    char vals[2 * MAX_WIN_LINE - 1];
+    for (int d = 0; d < 4; ++d) {
+        axis_cells(ctx, x, y, d, vals);
+        int cnt[2] = { 0, 0 }, off = 0;
+        for (int k = 0; k < 2 * len - 1; ++k) {
+            //  [k - len + 1, k]   vals
+            char v = vals[k];
+            if (v == 'X') cnt[0]++;
+            else if (v == 'O') cnt[1]++;
+            else if (v != '.') off++;
+            if (k >= len) {
+                char w = vals[k - len];
+                if (w == 'X') cnt[0]--;
+                else if (w == 'O') cnt[1]--;
+                else if (w != '.') off--;
+            }
+            if (k < len - 1 || off) continue;
+            threat_count(ctx, cnt[0], cnt[1], -delta);
+            threat_count(ctx, cnt[0] + (side == 0), cnt[1] + (side == 1), delta);
+        }
+    }
+}
+
+//       (    )
+void threat_rebuild(GameContext* ctx) {
+    int len = (int)ctx->parameters.len;
+    char vals[2 * MAX_WIN_LINE - 1];
+    memset(ctx->threats, 0, sizeof(ctx->threats));
+    unsigned long long it = 0;
+    Node node;
+    while (table_next(ctx->board, &it, &node)) {
+        for (int d = 0; d < 4; ++d) {
+            axis_cells(ctx, node.x, node.y, d, vals);
+            //      ,    
+            int prev = len - 2;
+            while (prev >= 0 && vals[prev] != 'X' && vals[prev] != 'O') prev--;
+            for (int start = prev + 1; start < len; ++start) {
+                int cnt[2] = { 0, 0 }, off = 0;
+                for (int k = start; k < start + len; ++k) {
+                    if (vals[k] == 'X') cnt[0]++;
+                    else if (vals[k] == 'O') cnt[1]++;
+                    else if (vals[k] != '.') off++;
+                }
+                if (!off) threat_count(ctx, cnt[0], cnt[1], 1);
+            }
         }
     }
-    return best_ai - best_pl;
+}
+
+//    k   :    len     10 
+int threat_weight(int len, int k) {
+    int w = 10000;
+    for (int miss = len - 1 - k; miss > 0 && w > 1; --miss) w /= 10;
+    return w;
+}
+
+/*        (  )
+   ,   make_move  unmake_move,   */
+int eval_heuristic(GameContext* ctx) {
+    base* parameters = &ctx->parameters;
+    int len = (int)parameters->len;
+    int ai = side_index(parameters->ai), pl = side_index(parameters->player);
+    long long score = 0;
+    for (int k = 1; k <= len; ++k) {
+        score += (long long)threat_weight(len, k) * (ctx->threats[ai][k] - ctx->threats[pl][k]);
+    }
+    //       
+    if (score > 50000) score = 50000;
+    if (score < -50000) score = -50000;
+    return (int)score;
 }
 
 /*        
@@ -296,20 +1060,52 @@ void bbox_on_place(bounds* bbox, long long x, long long y) {
     }
 }
 
-//        
+/*       
+    ,       */
 void bbox_on_remove(bounds* bbox, Table* board, unsigned long long size) {
     if (!bbox->initialized) return;
     long long nx = LLONG_MAX, ny = LLONG_MAX, xx = LLONG_MIN, yy = LLONG_MIN;
     bool found = false;
-    for (unsigned long long i = 0; i < board->capacity; ++i) {
-        Node* current = board->buckets[i];
-        while (current) {
+    if (board->use_bits) {
+        //     :     
+        unsigned long long all[LINE_WORDS] = { 0 };
+        for (long long y = 0; y < (long long)board->size; ++y) {
+            bool row = false;
+            for (int w = 0; w < LINE_WORDS; ++w) {
+                unsigned long long v = board->bits.rows[0][y][w] | board->bits.rows[1][y][w];
+                all[w] |= v;
+                if (v) row = true;
+            }
+            if (!row) continue;
+            if (!found) ny = y;
+            yy = y;
+            found = true;
+        }
+        for (int w = 0; w < LINE_WORDS && found; ++w) {
+            if (!all[w]) continue;
+            long long lo = w * 64 + ctz64(all[w]), hi = w * 64 + 63 - clz64(all[w]);
+            if (lo < nx) nx = lo;
+            if (hi > xx) xx = hi;
+        }
+    }
+    else {
+        //      
+        for (int i = 0; i < board->tile_count; ++i) {
+            Tile* t = &board->tiles[i];
+            if (!t->count) continue;
+            unsigned short cols = 0;
+            for (int ly = 0; ly < TILE_SIZE; ++ly) {
+                if (!t->occupied[ly]) continue;
+                cols |= t->occupied[ly];
+                long long y = t->ty * TILE_SIZE + ly;
+                if (y < ny) ny = y;
+                if (y > yy) yy = y;
+            }
+            long long x0 = t->tx * TILE_SIZE + ctz64(cols);
+            long long x1 = t->tx * TILE_SIZE + 63 - clz64(cols);
+            if (x0 < nx) nx = x0;
+            if (x1 > xx) xx = x1;
             found = true;
-            if (current->x < nx) nx = current->x;
-            if (current->x > xx) xx = current->x;
-            if (current->y < ny) ny = current->y;
-            if (current->y > yy) yy = current->y;
-            current = current->next;
         }
     }
     if (!found) {
@@ -323,300 +1119,2393 @@ void bbox_on_remove(bounds* bbox, Table* board, unsigned long long size) {
     bbox->initialized = true;
 }
 
-//  
+//   
+void cand_init(CandSet* set, unsigned long long cap) {
+    set->capacity = cap;
+    set->used = 0;
+    set->n = 0;
+    set->slots = (CandSlot*)calloc(cap, sizeof(CandSlot));
+    set->list = (int*)malloc(cap * sizeof(int));
+    if (!set->slots || !set->list) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+}
+
+void cand_free(CandSet* set) {
+    free(set->slots);
+    free(set->list);
+}
+
+void cand_clear(CandSet* set) {
+    memset(set->slots, 0, set->capacity * sizeof(CandSlot));
+    set->used = 0;
+    set->n = 0;
+}
+
+//   (x, y),    
+int cand_slot(CandSet* set, long long x, long long y) {
+    unsigned long long mask = set->capacity - 1;
+    unsigned long long i = hash_mix64(x, y, set->capacity);
+    while (set->slots[i].used) {
+        if (set->slots[i].x == x && set->slots[i].y == y) return (int)i;
+        i = (i + 1) & mask;
+    }
+    CandSlot* c = &set->slots[i];
+    c->x = x;
+    c->y = y;
+    c->near = 0;
+    c->index = -1;
+    c->stone = false;
+    c->used = true;
+    set->used++;
+    return (int)i;
+}
+
+//  ,    
+void cand_grow(CandSet* set) {
+    CandSet old = *set;
+    cand_init(set, old.capacity * 2);
+    int* remap = (int*)malloc(old.capacity * sizeof(int));
+    for (unsigned long long i = 0; i < old.capacity; ++i) {
+        if (!old.slots[i].used) continue;
+        int j = cand_slot(set, old.slots[i].x, old.slots[i].y);
+        set->slots[j].near = old.slots[i].near;
+        set->slots[j].stone = old.slots[i].stone;
+        remap[i] = j;
+    }
+    for (int k = 0; k < old.n; ++k) {
+        int j = remap[old.list[k]];
+        set->slots[j].index = k;
+        set->list[k] = j;
+    }
+    set->n = old.n;
+    free(remap);
+    cand_free(&old);
+}
+
+void cand_add(CandSet* set, int slot) {
+    set->slots[slot].index = set->n;
+    set->list[set->n++] = slot;
+}
+
+//         
+void cand_drop(CandSet* set, int slot) {
+    int i = set->slots[slot].index;
+    int last = set->list[--set->n];
+    set->list[i] = last;
+    set->slots[last].index = i;
+    set->slots[slot].index = -1;
+}
+
+//   (x, y)  (delta = 1)   (delta = -1)
+void cand_update(GameContext* ctx, long long x, long long y, int delta) {
+    CandSet* set = &ctx->cands;
+    if ((set->used + 25) * 2 > set->capacity) cand_grow(set);
+    for (int dy = -2; dy <= 2; ++dy) {
+        for (int dx = -2; dx <= 2; ++dx) {
+            if (!dx && !dy) continue;
+            long long nx = x + dx, ny = y + dy;
+            if (llabs(nx) > COORD_LIMIT || llabs(ny) > COORD_LIMIT) continue;
+            if (!ctx->parameters.infinite_field &&
+                (nx < 0 || ny < 0 || nx >= (long long)ctx->parameters.size || ny >= (long long)ctx->parameters.size)) continue;
+            int j = cand_slot(set, nx, ny);
+            CandSlot* c = &set->slots[j];
+            c->near += delta;
+            if (delta > 0 && c->near == 1 && !c->stone) cand_add(set, j);
+            if (delta < 0 && c->near == 0 && c->index >= 0) cand_drop(set, j);
+        }
+    }
+    int j = cand_slot(set, x, y);
+    CandSlot* c = &set->slots[j];
+    c->stone = delta > 0;
+    if (c->stone && c->index >= 0) cand_drop(set, j);
+    if (!c->stone && c->near > 0) cand_add(set, j);
+}
+
+//       (    )
+void cand_rebuild(GameContext* ctx) {
+    cand_clear(&ctx->cands);
+    unsigned long long it = 0;
+    Node node;
+    while (table_next(ctx->board, &it, &node)) cand_update(ctx, node.x, node.y, 1);
+}
+
+/*       ,     
+    insert,     */
+void make_move(GameContext* ctx, long long x, long long y, char value) {
+    if (ctx->undo_top == ctx->undo_capacity) {
+        ctx->undo_capacity *= 2;
+        ctx->undo = (UndoEntry*)realloc(ctx->undo, ctx->undo_capacity * sizeof(UndoEntry));
+        if (!ctx->undo) {
+            printf("Memory allocation error\n");
+            exit(1);
+        }
+    }
+    threat_update(ctx, x, y, value, 1);
+    cand_update(ctx, x, y, 1);
+    UndoEntry* u = &ctx->undo[ctx->undo_top++];
+    u->x = x;
+    u->y = y;
+    u->value = value;
+    u->bbox = ctx->bbox;
+    u->last_ai_x = ctx->parameters.last_ai_x;
+    u->last_ai_y = ctx->parameters.last_ai_y;
+    u->last_pl_x = ctx->parameters.last_pl_x;
+    u->last_pl_y = ctx->parameters.last_pl_y;
+
+    insert(ctx->board, x, y, value);
+    bbox_on_place(&ctx->bbox, x, y);
+    if (value == ctx->parameters.ai) {
+        ctx->parameters.last_ai_x = x;
+        ctx->parameters.last_ai_y = y;
+    }
+    else {
+        ctx->parameters.last_pl_x = x;
+        ctx->parameters.last_pl_y = y;
+    }
+    ctx->parameters.count_moves++;
+}
+
+//      
+void unmake_move(GameContext* ctx) {
+    UndoEntry* u = &ctx->undo[--ctx->undo_top];
+    remove_cell(ctx->board, u->x, u->y);
+    threat_update(ctx, u->x, u->y, u->value, -1);
+    cand_update(ctx, u->x, u->y, -1);
+    ctx->bbox = u->bbox; //   ,     
+    ctx->parameters.last_ai_x = u->last_ai_x;
+    ctx->parameters.last_ai_y = u->last_ai_y;
+    ctx->parameters.last_pl_x = u->last_pl_x;
+    ctx->parameters.last_pl_y = u->last_pl_y;
+    ctx->parameters.count_moves--;
+}
+
+//  :   ,   ,   
+void play_move(GameContext* ctx, long long x, long long y, char value) {
+    make_move(ctx, x, y, value);
+    ctx->undo_top--;
+}
+
+#define MOVES_INLINE 64 //        
+
+/* :  generate_candidates    ,    -  (y, x)
+ MOVES_INLINE     ,   K -    (heap_x  NULL),
+   best_move_free;     best_move_x, best_move_y, best_move_score,
+         */
 typedef struct {
-    long long x[64];
-    long long y[64];
-    int score[64];
-    int n;
+    long long* heap_x;
+    long long* heap_y;
+    int* heap_score;
+    int n, cap;
+    long long inline_x[MOVES_INLINE];
+    long long inline_y[MOVES_INLINE];
+    int inline_score[MOVES_INLINE];
 } best_move;
 
-//      
-void best_move_push(best_move* moves, long long x, long long y, int sc, short K) {
-    if (moves->n < K) {
+long long* best_move_x(best_move* moves) { return moves->heap_x ? moves->heap_x : moves->inline_x; }
+long long* best_move_y(best_move* moves) { return moves->heap_x ? moves->heap_y : moves->inline_y; }
+int* best_move_score(best_move* moves) { return moves->heap_x ? moves->heap_score : moves->inline_score; }
+
+//    K 
+void best_move_init(best_move* moves, int K) {
+    moves->n = 0;
+    moves->cap = K;
+    moves->heap_x = NULL;
+    moves->heap_y = NULL;
+    moves->heap_score = NULL;
+    if (K <= MOVES_INLINE) return;
+    moves->heap_x = (long long*)malloc(K * sizeof(long long));
+    moves->heap_y = (long long*)malloc(K * sizeof(long long));
+    moves->heap_score = (int*)malloc(K * sizeof(int));
+    if (!moves->heap_x || !moves->heap_y || !moves->heap_score) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+}
+
+void best_move_free(best_move* moves) {
+    if (!moves->heap_x) return;
+    free(moves->heap_x);
+    free(moves->heap_y);
+    free(moves->heap_score);
+    moves->heap_x = NULL;
+    moves->heap_y = NULL;
+    moves->heap_score = NULL;
+    moves->n = 0;
+    moves->cap = MOVES_INLINE;
+}
+
+//  a   b:  ,   -   (y, x)
+bool move_worse(int sa, long long ya, long long xa, int sb, long long yb, long long xb) {
+    if (sa != sb) return sa < sb;
+    if (ya != yb) return ya > yb;
+    return xa > xb;
+}
+
+bool best_move_worse(best_move* moves, int i, int j) {
+    long long* mx = best_move_x(moves);
+    long long* my = best_move_y(moves);
+    int* ms = best_move_score(moves);
+    return move_worse(ms[i], my[i], mx[i], ms[j], my[j], mx[j]);
+}
+
+//     i 
+void best_move_set(best_move* moves, int i, long long x, long long y, int sc) {
+    best_move_x(moves)[i] = x;
+    best_move_y(moves)[i] = y;
+    best_move_score(moves)[i] = sc;
+}
+
+void best_move_swap(best_move* moves, int i, int j) {
+    long long* mx = best_move_x(moves);
+    long long* my = best_move_y(moves);
+    int* ms = best_move_score(moves);
+    long long tx = mx[i], ty = my[i];
+    int ts = ms[i];
+    mx[i] = mx[j];
+    my[i] = my[j];
+    ms[i] = ms[j];
+    mx[j] = tx;
+    my[j] = ty;
+    ms[j] = ts;
+}
+
+//      n ,   
+void best_move_sift(best_move* moves, int i, int n) {
+    for (;;) {
+        int worst = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < n && best_move_worse(moves, l, worst)) worst = l;
+        if (r < n && best_move_worse(moves, r, worst)) worst = r;
+        if (worst == i) return;
+        best_move_swap(moves, i, worst);
+        i = worst;
+    }
+}
+
+/* :   ,    ,
+    ,   , - O(log K)    */
+void best_move_push(best_move* moves, long long x, long long y, int sc) {
+    if (moves->n < moves->cap) {
         int i = moves->n++;
-        moves->x[i] = x;
-        moves->y[i] = y;
-        moves->score[i] = sc;
-        while (i > 0 && moves->score[i] > moves->score[i - 1]) {
-            int temp_sc = moves->score[i - 1];
-            moves->score[i - 1] = moves->score[i];
-            moves->score[i] = temp_sc;
-            long long temp_x = moves->x[i - 1], temp_y = moves->y[i - 1];
-            moves->x[i - 1] = moves->x[i];
-            moves->y[i - 1] = moves->y[i];
-            moves->x[i] = temp_x;
-            moves->y[i] = temp_y;
-            i--;
+        best_move_set(moves, i, x, y, sc);
+        while (i > 0 && best_move_worse(moves, i, (i - 1) / 2)) {
+            best_move_swap(moves, i, (i - 1) / 2);
+            i = (i - 1) / 2;
         }
         return;
     }
-    if (sc <= moves->score[moves->n - 1]) return;
-    int i = moves->n - 1;
-    while (i > 0 && sc > moves->score[i - 1]) {
-        moves->score[i] = moves->score[i - 1];
-        moves->x[i] = moves->x[i - 1];
-        moves->y[i] = moves->y[i - 1];
-        i--;
+    if (moves->cap == 0 || !move_worse(best_move_score(moves)[0], best_move_y(moves)[0], best_move_x(moves)[0], sc, y, x)) return;
+    best_move_set(moves, 0, x, y, sc);
+    best_move_sift(moves, 0, moves->n);
+}
+
+//    :      
+void best_move_finish(best_move* moves) {
+    for (int end = moves->n - 1; end > 0; --end) {
+        best_move_swap(moves, 0, end);
+        best_move_sift(moves, 0, end);
     }
-    moves->score[i] = sc;
-    moves->x[i] = x;
-    moves->y[i] = y;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //     
-void generate_candidates(Table* board, base* parameters, bounds* bbox, bool forAI, short K, best_move* out, GameContext* ctx) {
-    out->n = 0;
-    short R = 2;
+void generate_candidates(Table* board, base* parameters, bounds* bbox, bool forAI, int K, best_move* out, GameContext* ctx) {
+    best_move_init(out, K);
 
     if (!bbox->initialized) {
         long long c = 0; //       (0,0)
         if (get_value(board, c, c, parameters->size, ctx) == '.') {
-            best_move_push(out, c, c, 0, K);
+            best_move_push(out, c, c, 0);
         }
         return;
     }
 
-    //         bbox
-    long long x0 = bbox->minx - R;
-    long long x1 = bbox->maxx + R;
-    long long y0 = bbox->miny - R;
-    long long y1 = bbox->maxy + R;
-
-    //      
-    if (x1 - x0 > 20) x1 = x0 + 20;
-    if (y1 - y0 > 20) y1 = y0 + 20;
+    //     2       
+    for (int i = 0; i < ctx->cands.n; ++i) {
+        CandSlot* c = &ctx->cands.slots[ctx->cands.list[i]];
+        long long x = c->x, y = c->y;
+        int neighbors = c->near;
 
-    for (long long y = y0; y <= y1; ++y) {
-        for (long long x = x0; x <= x1; ++x) {
-            if (get_value(board, x, y, parameters->size, ctx) != '.') continue;
+        int score_ai = line_score(board, parameters->size, parameters->len, x, y, parameters->ai, ctx);
+        int score_pl = line_score(board, parameters->size, parameters->len, x, y, parameters->player, ctx);
+        int sc = forAI ? score_ai - (score_pl / 2) : score_pl - (score_ai / 2);
+        sc += neighbors * 1000;
 
-            int neighbors = 0;
-            for (int dx = -2; dx <= 2; ++dx) {
-                for (int dy = -2; dy <= 2; ++dy) {
-                    if (!dx && !dy) continue;
-                    char value = get_value(board, x + dx, y + dy, parameters->size, ctx);
-                    if (value == parameters->ai || value == parameters->player) {
-                        neighbors++;
-                    }
-                }
-            }
+        best_move_push(out, x, y, sc);
+    }
+    best_move_finish(out);
+}
 
-            if (!neighbors && parameters->count_moves > 0) continue;
+//   :   ,        
+bool no_moves_left(GameContext* ctx) {
+    return ctx->bbox.initialized && ctx->cands.n == 0;
+}
 
-            int score_ai = line_score(board, parameters->size, parameters->len, x, y, parameters->ai, ctx);
-            int score_pl = line_score(board, parameters->size, parameters->len, x, y, parameters->player, ctx);
-            int sc = forAI ? score_ai - (score_pl / 2) : score_pl - (score_ai / 2);
-            sc += neighbors * 1000;
+//   
+bool find_immediate_move(Table* board, base* parameters, bounds* bbox, bool forAI, long long* bx, long long* by, GameContext* ctx) {
+    best_move cand;
+    int K;
+    if (parameters->infinite_field == 1) {
+        K = 200;
+    }
+    else {
+        K = 64;
+    }
+    generate_candidates(board, parameters, bbox, forAI, K, &cand, ctx);
+    char me = forAI ? parameters->ai : parameters->player;
+    bool found = false;
+    for (int i = 0; i < cand.n && !found; ++i) {
+        long long x = best_move_x(&cand)[i], y = best_move_y(&cand)[i];
+        if (check_win(board, parameters->size, parameters->len, x, y, me, ctx)) { //    
+            *bx = x;
+            *by = y;
+            found = true;
+        }
+    }
+    best_move_free(&cand);
+    return found;
+}
 
-            best_move_push(out, x, y, sc, K);
+//         
+bool find_adjacent_move(Table* board, base* parameters, bounds* bbox, long long* bx, long long* by, GameContext* ctx) {
+    if (parameters->last_pl_x == LLONG_MAX || parameters->last_pl_y == LLONG_MAX)
+        return false;
+
+    //   8  
+    int directions[8][2] = { {-1,0}, {1,0}, {0,-1}, {0,1}, {-1,1}, {1,-1}, {1,1}, {-1,-1} };
+
+    for (int i = 0; i < 8; i++) {
+        long long nx = parameters->last_pl_x + directions[i][0];
+        long long ny = parameters->last_pl_y + directions[i][1];
+
+        // ,       (  )
+        if (parameters->infinite_field == 0 &&
+            (nx < 0 || nx >= parameters->size || ny < 0 || ny >= parameters->size)) {
+            continue;
+        }
+
+        // ,   
+        if (get_value(board, nx, ny, parameters->size, ctx) == '.') {
+            *bx = nx;
+            *by = ny;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+//       mb 
+TransTable* create_tt(unsigned int mb) {
+    unsigned long long n = 1;
+    while (n * 2 * sizeof(TTBucket) <= (unsigned long long)mb * 1024 * 1024) n <<= 1;
+    TransTable* tt = (TransTable*)malloc(sizeof(TransTable));
+    tt->buckets = (TTBucket*)calloc(n, sizeof(TTBucket));
+    tt->mask = n - 1;
+    tt->mb = mb;
+    tt->generation = 0;
+    return tt;
+}
+
+void free_tt(TransTable* tt) {
+    free(tt->buckets);
+    free(tt);
+}
+
+//     ,      
+TransTable* reset_tt(TransTable* tt, unsigned int mb) {
+    if (tt && tt->mb == mb) {
+        memset(tt->buckets, 0, (tt->mask + 1) * sizeof(TTBucket));
+        tt->generation = 0;
+        return tt;
+    }
+    if (tt) free_tt(tt);
+    return create_tt(mb);
+}
+
+//   :   ,  
+unsigned long long tt_key(Table* board, bool isMax) {
+    return board->zobrist ^ (isMax ? 0x5bd1e9955bd1e995ULL : 0);
+}
+
+//    ;    check,         
+void tt_load(TTSlot* slot, TTEntry* e) {
+    unsigned long long check = tt_word_load(slot->check);
+    unsigned long long data = tt_word_load(slot->data);
+    unsigned long long x = tt_word_load(slot->x);
+    unsigned long long y = tt_word_load(slot->y);
+    e->key = check ^ data ^ x ^ y;
+    e->score = (int)(unsigned int)data;
+    e->depth = (short)(unsigned short)(data >> 32);
+    e->bound = (unsigned char)((data >> 48) & 0x7f);
+    e->has_move = (data >> 55) & 1;
+    e->generation = (unsigned char)(data >> 56);
+    e->best_x = (long long)x;
+    e->best_y = (long long)y;
+}
+
+void tt_save(TTSlot* slot, TTEntry* e) {
+    unsigned long long data = (unsigned long long)(unsigned int)e->score
+        | (unsigned long long)(unsigned short)e->depth << 32
+        | (unsigned long long)(e->bound | (e->has_move ? 0x80 : 0)) << 48
+        | (unsigned long long)e->generation << 56;
+    unsigned long long x = (unsigned long long)e->best_x, y = (unsigned long long)e->best_y;
+    tt_word_store(slot->check, e->key ^ data ^ x ^ y);
+    tt_word_store(slot->data, data);
+    tt_word_store(slot->x, x);
+    tt_word_store(slot->y, y);
+}
+
+//     out; NULL,     
+TTEntry* tt_probe(TransTable* tt, unsigned long long key, TTEntry* out) {
+    TTBucket* b = &tt->buckets[key & tt->mask];
+    tt_load(&b->deep, out);
+    if (out->key == key) return out;
+    tt_load(&b->recent, out);
+    if (out->key == key) return out;
+    return NULL;
+}
+
+void tt_store(TransTable* tt, unsigned long long key, short depth, int score, tt_bound bound,
+    bool has_move, long long best_x, long long best_y) {
+    TTBucket* b = &tt->buckets[key & tt->mask];
+    TTEntry deep, e;
+    tt_load(&b->deep, &deep);
+    TTSlot* slot;
+    if (deep.key == key || depth >= deep.depth || deep.generation != tt->generation) {
+        slot = &b->deep;
+        e = deep;
+    }
+    else {
+        slot = &b->recent;
+        tt_load(slot, &e);
+    }
+    //       ,   
+    if (!has_move && e.key == key && e.has_move) {
+        has_move = true;
+        best_x = e.best_x;
+        best_y = e.best_y;
+    }
+    e.key = key;
+    e.score = score;
+    e.depth = depth;
+    e.bound = (unsigned char)bound;
+    e.generation = tt->generation;
+    e.has_move = has_move;
+    e.best_x = best_x;
+    e.best_y = best_y;
+    tt_save(slot, &e);
+}
+
+//   (x, y),     ,     
+void best_move_to_front(best_move* moves, long long x, long long y) {
+    long long* mx = best_move_x(moves);
+    long long* my = best_move_y(moves);
+    int* ms = best_move_score(moves);
+    for (int i = 1; i < moves->n; ++i) {
+        if (mx[i] != x || my[i] != y) continue;
+        int sc = ms[i];
+        for (; i > 0; --i) {
+            mx[i] = mx[i - 1];
+            my[i] = my[i - 1];
+            ms[i] = ms[i - 1];
+        }
+        best_move_set(moves, 0, x, y, sc);
+        return;
+    }
+}
+
+//         
+void order_tt_move(best_move* moves, TTEntry* hit) {
+    if (!hit || !hit->has_move) return;
+    best_move_to_front(moves, hit->best_x, hit->best_y);
+}
+
+//     :          
+int* history_cell(GameContext* ctx, int side, long long x, long long y) {
+    int hx = (int)((unsigned long long)(x - ctx->history_x0) & (HISTORY_SIZE - 1));
+    int hy = (int)((unsigned long long)(y - ctx->history_y0) & (HISTORY_SIZE - 1));
+    return &ctx->history[side][hy][hx];
+}
+
+//  -      
+void reset_move_order(GameContext* ctx) {
+    for (int ply = 0; ply < MAX_PLY; ++ply) {
+        ctx->killer_x[ply][0] = ctx->killer_x[ply][1] = LLONG_MAX;
+        ctx->killer_y[ply][0] = ctx->killer_y[ply][1] = LLONG_MAX;
+    }
+    memset(ctx->history, 0, sizeof(ctx->history));
+    ctx->history_x0 = ctx->history_y0 = 0;
+    if (ctx->parameters.infinite_field && ctx->bbox.initialized) {
+        ctx->history_x0 = ctx->bbox.minx - 2;
+        ctx->history_y0 = ctx->bbox.miny - 2;
+    }
+}
+
+//  (x, y)     depth:     ply    
+void note_cutoff(GameContext* ctx, int side, long long x, long long y, short depth) {
+    int ply = ctx->undo_top;
+    if (ply < MAX_PLY && (ctx->killer_x[ply][0] != x || ctx->killer_y[ply][0] != y)) {
+        ctx->killer_x[ply][1] = ctx->killer_x[ply][0];
+        ctx->killer_y[ply][1] = ctx->killer_y[ply][0];
+        ctx->killer_x[ply][0] = x;
+        ctx->killer_y[ply][0] = y;
+    }
+    *history_cell(ctx, side, x, y) += depth * depth;
+}
+
+/*   :    ,    ply,
+    ,    -    generate_candidates*/
+void order_moves(GameContext* ctx, best_move* moves, TTEntry* hit, int side) {
+    long long* mx = best_move_x(moves);
+    long long* my = best_move_y(moves);
+    int* ms = best_move_score(moves);
+    for (int i = 1; i < moves->n; ++i) {
+        long long x = mx[i], y = my[i];
+        int sc = ms[i];
+        int h = *history_cell(ctx, side, x, y);
+        int j = i;
+        for (; j > 0 && *history_cell(ctx, side, mx[j - 1], my[j - 1]) < h; --j) {
+            mx[j] = mx[j - 1];
+            my[j] = my[j - 1];
+            ms[j] = ms[j - 1];
+        }
+        best_move_set(moves, j, x, y, sc);
+    }
+    int ply = ctx->undo_top;
+    if (ply < MAX_PLY) {
+        for (int k = 1; k >= 0; --k) {
+            if (ctx->killer_x[ply][k] != LLONG_MAX) best_move_to_front(moves, ctx->killer_x[ply][k], ctx->killer_y[ply][k]);
+        }
+    }
+    order_tt_move(moves, hit);
+}
+
+//    
+long long now_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+#ifndef NO_THREADS
+/*  YBWC:  ,     ,    
+   ,      */
+typedef struct SplitPoint {
+    mtx_t lock;
+    cnd_t done;
+    struct SplitPoint* parent; // ,    ;     
+    best_move* moves;
+    long long path_x[MAX_PLY], path_y[MAX_PLY]; //     ,      
+    char path_value[MAX_PLY];
+    int path_len;
+    bool isMax;
+    short depth;
+    int next; //     
+    int alpha, beta;
+    int best;
+    long long best_x, best_y;
+    int helpers;     // ,  ,    
+    bool aborted;    //    ,   
+    atomic_bool cut; // :    ,   
+} SplitPoint;
+
+//    sp      
+bool split_cut(SplitPoint* sp) {
+    for (; sp; sp = sp->parent) {
+        if (atomic_load_explicit(&sp->cut, memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
+void pool_cancel(struct SearchPool* pool);
+#endif
+
+//   ; true,             
+bool search_tick(GameContext* ctx) {
+    //     1024 ,     
+    if (ctx->search_abort) return true;
+    if ((++ctx->search_nodes & 1023) == 0) {
+        if (ctx->search_deadline && now_ms() >= ctx->search_deadline) ctx->search_abort = true;
+#ifndef NO_THREADS
+        if (ctx->stop && atomic_load_explicit(ctx->stop, memory_order_relaxed)) {
+            ctx->search_abort = true;
+            //      ,        
+            if (ctx->pool) pool_cancel(ctx->pool);
+        }
+#endif
+    }
+#ifdef NO_THREADS
+    return ctx->search_abort;
+#else
+    if (ctx->search_abort) return true;
+    //    ,      ;    
+    return ctx->split && split_cut(ctx->split);
+#endif
+}
+
+//   :       
+bool search_stopped(GameContext* ctx) {
+#ifdef NO_THREADS
+    return ctx->search_abort;
+#else
+    return ctx->search_abort || (ctx->split && split_cut(ctx->split));
+#endif
+}
+
+/*,   s   :    (  2)    
+  -     len - 1 ,      */
+int winning_spots(GameContext* ctx, char s, long long* bx, long long* by) {
+    if (ctx->threats[side_index(s)][ctx->parameters.len - 1] == 0) return 0;
+    int spots = 0;
+    for (int i = 0; i < ctx->cands.n && spots < 2; ++i) {
+        CandSlot* c = &ctx->cands.slots[ctx->cands.list[i]];
+        if (!check_win(ctx->board, ctx->parameters.size, ctx->parameters.len, c->x, c->y, s, ctx)) continue;
+        if (spots++ == 0) {
+            *bx = c->x;
+            *by = c->y;
+        }
+    }
+    return spots;
+}
+
+/*  :     - ,  ,
+         ,     
+  len - 1  len - 2     ,      */
+//    quiesce  quiesce_enter
+typedef enum {
+    QUIESCE_DONE,   //  
+    QUIESCE_BLOCK,  //   ,   -  
+    QUIESCE_FORCING //   ,    -  
+} quiesce_kind;
+
+/*  quiesce:  QUIESCE_DONE   *val,  QUIESCE_BLOCK   -   forcing,
+ QUIESCE_FORCING   forcing, *val -   ,    */
+quiesce_kind quiesce_enter(GameContext* ctx, bool isMax, int* alpha, int* beta, short qdepth, int* val, best_move* forcing) {
+    Table* board = ctx->board;
+    base* parameters = &ctx->parameters;
+    *val = 0;
+    if (search_tick(ctx)) return QUIESCE_DONE;
+    int len = (int)parameters->len;
+    char me = isMax ? parameters->ai : parameters->player;
+    char opp = isMax ? parameters->player : parameters->ai;
+    int my = side_index(me), op = side_index(opp);
+    int win = isMax ? 100000 - (int)parameters->count_moves : -100000 + (int)parameters->count_moves;
+    int loss = isMax ? -100000 + (int)parameters->count_moves + 1 : 100000 - (int)parameters->count_moves - 1;
+
+    //   len - 1      -   
+    *val = win;
+    if (ctx->threats[my][len - 1] > 0) return QUIESCE_DONE;
+
+    int stand = eval_heuristic(ctx);
+    *val = stand;
+    if (ctx->threats[op][len - 1] > 0) {
+        //   :    ,   
+        long long bx = 0, by = 0;
+        int spots = winning_spots(ctx, opp, &bx, &by);
+        if (spots >= 2) *val = loss;
+        if (spots >= 2 || spots == 0 || qdepth <= 0) return QUIESCE_DONE;
+        best_move_init(forcing, 1);
+        best_move_push(forcing, bx, by, 0);
+        best_move_finish(forcing);
+        return QUIESCE_BLOCK;
+    }
+    if (qdepth <= 0 || len < 3) return QUIESCE_DONE;
+    if (ctx->threats[my][len - 2] == 0 && ctx->threats[op][len - 2] == 0) return QUIESCE_DONE; //  
+
+    //  " ":        
+    if (isMax) {
+        if (stand >= *beta) return QUIESCE_DONE;
+        if (stand > *alpha) *alpha = stand;
+    }
+    else {
+        if (stand <= *alpha) return QUIESCE_DONE;
+        if (stand < *beta) *beta = stand;
+    }
+    if (!ctx->patterns) return QUIESCE_DONE; //      
+
+    best_move_init(forcing, 8);
+    for (int i = 0; i < ctx->cands.n; ++i) {
+        CandSlot* c = &ctx->cands.slots[ctx->cands.list[i]];
+        int attack = line_score(board, parameters->size, parameters->len, c->x, c->y, me, ctx);
+        int defend = line_score(board, parameters->size, parameters->len, c->x, c->y, opp, ctx);
+        if (attack >= SHAPE_OPEN_THREE || defend >= SHAPE_OPEN_FOUR) best_move_push(forcing, c->x, c->y, attack + defend / 2);
+    }
+    best_move_finish(forcing);
+    return QUIESCE_FORCING;
+}
+
+//       quiesce; true,   
+bool quiesce_update(bool isMax, int* alpha, int* beta, int* best, int val) {
+    if (isMax) {
+        if (val > *best) *best = val;
+        if (*best > *alpha) *alpha = *best;
+    }
+    else {
+        if (val < *best) *best = val;
+        if (*best < *beta) *beta = *best;
+    }
+    return *alpha >= *beta;
+}
+
+int quiesce(Table* board, base* parameters, bounds* bbox, bool isMax, int alpha, int beta, short qdepth, GameContext* ctx) {
+    int best;
+    best_move forcing;
+    quiesce_kind kind = quiesce_enter(ctx, isMax, &alpha, &beta, qdepth, &best, &forcing);
+    if (kind == QUIESCE_DONE) return best;
+    char me = isMax ? parameters->ai : parameters->player;
+    if (kind == QUIESCE_BLOCK) {
+        make_move(ctx, best_move_x(&forcing)[0], best_move_y(&forcing)[0], me);
+        int val = quiesce(board, parameters, bbox, !isMax, alpha, beta, qdepth - 1, ctx);
+        unmake_move(ctx);
+        return val;
+    }
+    for (int i = 0; i < forcing.n; ++i) {
+        make_move(ctx, best_move_x(&forcing)[i], best_move_y(&forcing)[i], me);
+        int val = quiesce(board, parameters, bbox, !isMax, alpha, beta, qdepth - 1, ctx);
+        unmake_move(ctx);
+        if (quiesce_update(isMax, &alpha, &beta, &best, val)) break;
+    }
+    return best;
+}
+
+/*  :         ,   ,
+   ,       -     
+  ,         */
+bool null_move_ok(GameContext* ctx, bool isMax, int alpha, int beta, short depth) {
+    base* p = &ctx->parameters;
+    if (!p->use_null_move || ctx->null_move || depth < NULL_MOVE_R + 1) return false;
+    if (isMax ? beta == INT_MAX : alpha == INT_MIN) return false;
+    int len = (int)p->len;
+    int my = side_index(isMax ? p->ai : p->player), op = side_index(isMax ? p->player : p->ai);
+    if (len < 3 || ctx->threats[my][len - 1] || ctx->threats[op][len - 1] || ctx->threats[op][len - 2]) return false;
+    int stand = eval_heuristic(ctx);
+    return isMax ? stand >= beta : stand <= alpha;
+}
+
+//  ,         ,      
+bool lmr_ok(GameContext* ctx, int i, short depth, long long x, long long y, char me, char opp) {
+    base* p = &ctx->parameters;
+    if (!p->use_lmr || i < LMR_FULL_MOVES || depth < 3) return false;
+    if (line_score(ctx->board, p->size, p->len, x, y, me, ctx) >= SHAPE_OPEN_THREE) return false;
+    return line_score(ctx->board, p->size, p->len, x, y, opp, ctx) < SHAPE_OPEN_THREE;
+}
+
+int minimax(Table* board, base* parameters, bounds* bbox, bool isMax, int alpha, int beta, short depth, GameContext* ctx);
+#ifndef NO_THREADS
+bool split_ok(GameContext* ctx, short depth, int n);
+void split_search(GameContext* ctx, best_move* moves, bool isMax, int* alpha, int* beta, short depth,
+    int* best, long long* best_x, long long* best_y);
+#endif
+
+/* i-    depth:  ,  ,       
+      */
+int child_value(GameContext* ctx, bool isMax, int alpha, int beta, short depth, int i, long long x, long long y) {
+    base* p = &ctx->parameters;
+    char me = isMax ? p->ai : p->player;
+    char opp = isMax ? p->player : p->ai;
+    bool reduce = lmr_ok(ctx, i, depth, x, y, me, opp);
+    make_move(ctx, x, y, me);
+    int val = 0;
+    if (isMax) {
+        //  :     alpha,     
+        if (reduce) val = minimax(ctx->board, p, &ctx->bbox, false, alpha, alpha + 1, depth - 2, ctx);
+        if (!reduce || val > alpha) {
+            if (i == 0 || p->search_mode != PVS) {
+                val = minimax(ctx->board, p, &ctx->bbox, false, alpha, beta, depth - 1, ctx);
+            }
+            else {
+                //    ,    alpha;   -     
+                val = minimax(ctx->board, p, &ctx->bbox, false, alpha, alpha + 1, depth - 1, ctx);
+                if (val > alpha && val < beta) val = minimax(ctx->board, p, &ctx->bbox, false, alpha, beta, depth - 1, ctx);
+            }
+        }
+    }
+    else {
+        if (reduce) val = minimax(ctx->board, p, &ctx->bbox, true, beta - 1, beta, depth - 2, ctx);
+        if (!reduce || val < beta) {
+            if (i == 0 || p->search_mode != PVS) {
+                val = minimax(ctx->board, p, &ctx->bbox, true, alpha, beta, depth - 1, ctx);
+            }
+            else {
+                val = minimax(ctx->board, p, &ctx->bbox, true, beta - 1, beta, depth - 1, ctx);
+                if (val < beta && val > alpha) val = minimax(ctx->board, p, &ctx->bbox, true, alpha, beta, depth - 1, ctx);
+            }
+        }
+    }
+    unmake_move(ctx);
+    return val;
+}
+
+//  :     ; true,     ,   *val
+bool node_enter(GameContext* ctx, int* val) {
+    Table* board = ctx->board;
+    base* parameters = &ctx->parameters;
+    *val = 0;
+    if (search_tick(ctx)) return true;
+    if (parameters->last_ai_x != LLONG_MAX &&
+        check_win(board, parameters->size, parameters->len, parameters->last_ai_x, parameters->last_ai_y, parameters->ai, ctx)) {
+        *val = 100000 - (int)parameters->count_moves;
+        return true;
+    }
+    if (parameters->last_pl_x != LLONG_MAX &&
+        check_win(board, parameters->size, parameters->len, parameters->last_pl_x, parameters->last_pl_y, parameters->player, ctx)) {
+        *val = -100000 + (int)parameters->count_moves;
+        return true;
+    }
+    return false;
+}
+
+//    : true,     ,   *val
+bool node_probe(GameContext* ctx, bool isMax, int alpha, int beta, short depth, int* val,
+    unsigned long long* key, TTEntry* entry, TTEntry** hit) {
+    *key = tt_key(ctx->board, isMax);
+    *hit = tt_probe(ctx->tt, *key, entry);
+    TTEntry* h = *hit;
+    if (h && h->depth >= depth) {
+        *val = h->score;
+        if (h->bound == TT_EXACT) return true;
+        if (h->bound == TT_LOWER && h->score >= beta) return true;
+        if (h->bound == TT_UPPER && h->score <= alpha) return true;
+    }
+    return false;
+}
+
+//     : true,   ,   *val
+bool null_cutoff(GameContext* ctx, bool isMax, int alpha, int beta, int* val) {
+    if (search_stopped(ctx)) {
+        *val = 0;
+        return true;
+    }
+    if (isMax && *val >= beta) {
+        *val = beta;
+        return true;
+    }
+    if (!isMax && *val <= alpha) {
+        *val = alpha;
+        return true;
+    }
+    return false;
+}
+
+//      tk; true,         ,   *val
+bool node_moves(GameContext* ctx, bool isMax, short depth, TTEntry* hit, best_move* tk, int* val) {
+    base* parameters = &ctx->parameters;
+    int K = (depth >= 2 ? 24 : 16);
+    generate_candidates(ctx->board, parameters, &ctx->bbox, isMax, K, tk, ctx);
+    *val = 0;
+    if (tk->n == 0) return true;
+    char me = isMax ? parameters->ai : parameters->player;
+    order_moves(ctx, tk, hit, side_index(me));
+    for (int i = 0; i < tk->n; ++i) {
+        if (check_win(ctx->board, parameters->size, parameters->len, best_move_x(tk)[i], best_move_y(tk)[i], me, ctx)) {
+            *val = isMax ? 100000 - (int)parameters->count_moves : -100000 + (int)parameters->count_moves;
+            return true;
+        }
+    }
+    return false;
+}
+
+//   (x, y)   ; true,        
+bool node_update(GameContext* ctx, bool isMax, int* alpha, int* beta, short depth, int val, long long x, long long y,
+    int* best, long long* best_x, long long* best_y) {
+    if (isMax ? val > *best : val < *best) {
+        *best = val;
+        *best_x = x;
+        *best_y = y;
+    }
+    if (isMax && *best > *alpha) *alpha = *best;
+    if (!isMax && *best < *beta) *beta = *best;
+    if (*alpha < *beta) return false;
+    note_cutoff(ctx, side_index(isMax ? ctx->parameters.ai : ctx->parameters.player), x, y, depth);
+    return true;
+}
+
+//      ,    
+void node_store(GameContext* ctx, unsigned long long key, short depth, int best, int alpha0, int beta0,
+    long long best_x, long long best_y) {
+    if (search_stopped(ctx)) return; //  ,    
+    tt_bound bound = best <= alpha0 ? TT_UPPER : (best >= beta0 ? TT_LOWER : TT_EXACT);
+    tt_store(ctx->tt, key, depth, best, bound, true, best_x, best_y);
+}
+
+// 
+int minimax(Table* board, base* parameters, bounds* bbox, bool isMax, int alpha, int beta, short depth, GameContext* ctx) {
+    int val;
+    unsigned long long key;
+    TTEntry entry;
+    TTEntry* hit;
+    if (node_enter(ctx, &val)) return val;
+    if (depth <= 0) return quiesce(board, parameters, bbox, isMax, alpha, beta, QUIESCE_DEPTH, ctx);
+    if (node_probe(ctx, isMax, alpha, beta, depth, &val, &key, &entry, &hit)) return val;
+    int alpha0 = alpha, beta0 = beta;
+
+    if (null_move_ok(ctx, isMax, alpha, beta, depth)) {
+        //      ,     
+        ctx->null_move = true;
+        val = isMax ? minimax(board, parameters, bbox, false, beta - 1, beta, depth - 1 - NULL_MOVE_R, ctx)
+            : minimax(board, parameters, bbox, true, alpha, alpha + 1, depth - 1 - NULL_MOVE_R, ctx);
+        ctx->null_move = false;
+        if (null_cutoff(ctx, isMax, alpha, beta, &val)) return val;
+    }
+
+    best_move tk;
+    if (node_moves(ctx, isMax, depth, hit, &tk, &val)) return val;
+    int best = isMax ? INT_MIN : INT_MAX;
+    long long best_x = best_move_x(&tk)[0], best_y = best_move_y(&tk)[0];
+    for (int i = 0; i < tk.n; ++i) {
+        long long x = best_move_x(&tk)[i], y = best_move_y(&tk)[i];
+        val = child_value(ctx, isMax, alpha, beta, depth, i, x, y);
+        if (node_update(ctx, isMax, &alpha, &beta, depth, val, x, y, &best, &best_x, &best_y)) break;
+#ifndef NO_THREADS
+        //      ,      
+        if (i == 0 && split_ok(ctx, depth, tk.n)) {
+            split_search(ctx, &tk, isMax, &alpha, &beta, depth, &best, &best_x, &best_y);
+            break;
+        }
+#endif
+    }
+    node_store(ctx, key, depth, best, alpha0, beta0, best_x, best_y);
+    return best;
+}
+
+//   (x, y)   s :    len - 2  ,      
+bool makes_four(GameContext* ctx, long long x, long long y, char s) {
+    int len = (int)ctx->parameters.len;
+    char vals[2 * MAX_WIN_LINE - 1];
+    for (int d = 0; d < 4; ++d) {
+        axis_cells(ctx, x, y, d, vals);
+        int own = 0, bad = 0;
+        for (int k = 0; k < 2 * len - 1; ++k) {
+            if (vals[k] == s) own++;
+            else if (vals[k] != '.') bad++;
+            if (k >= len) {
+                if (vals[k - len] == s) own--;
+                else if (vals[k - len] != '.') bad--;
+            }
+            if (k >= len - 1 && !bad && own == len - 2) return true;
+        }
+    }
+    return false;
+}
+
+void threat_cache_clear(GameContext* ctx) {
+    memset(ctx->threat_cache, 0, THREAT_CACHE_SIZE * sizeof(ThreatEntry));
+}
+
+//      ,       
+bool threat_stopped(GameContext* ctx) {
+    return ctx->threat_nodes > ctx->threat_limit || ctx->threat_paused || ctx->search_abort;
+}
+
+bool threat_defend(GameContext* ctx, char att, char def, short depth, bool vct);
+
+/*   :     (vct = false)     ,
+ -   ; true,       depth  
+ ,         */
+bool threat_attack(GameContext* ctx, char att, char def, short depth, bool vct, long long* bx, long long* by) {
+    ctx->threat_nodes++;
+    if (ctx->threat_pause && (ctx->threat_nodes & 15) == 0 && now_ms() >= ctx->threat_pause) ctx->threat_paused = true;
+    if (search_tick(ctx) || threat_stopped(ctx)) return false;
+    if (winning_spots(ctx, att, bx, by)) return true;
+    long long fx = 0, fy = 0;
+    int forced = winning_spots(ctx, def, &fx, &fy);
+    if (forced >= 2 || depth <= 0) return false;
+
+    unsigned long long key = ctx->board->zobrist ^ (side_index(att) ? 0x2545f4914f6cdd1dULL : 0) ^ (vct ? 0x9e3779b97f4a7c15ULL : 0);
+    ThreatEntry* e = &ctx->threat_cache[key & (THREAT_CACHE_SIZE - 1)];
+    if (e->key == key) {
+        if (e->won && e->depth <= depth) {
+            *bx = e->move_x;
+            *by = e->move_y;
+            return true;
+        }
+        if (!e->won && e->depth >= depth) return false;
+    }
+
+    //    -    ,      
+    best_move moves;
+    best_move_init(&moves, 16);
+    bool triples = vct && ctx->patterns;
+    for (int i = 0; i < ctx->cands.n; ++i) {
+        CandSlot* c = &ctx->cands.slots[ctx->cands.list[i]];
+        if (forced && (c->x != fx || c->y != fy)) continue;
+        if (makes_four(ctx, c->x, c->y, att)) {
+            best_move_push(&moves, c->x, c->y, SHAPE_FIVE + c->near);
+            continue;
+        }
+        if (!triples) continue;
+        int sc = line_score(ctx->board, ctx->parameters.size, ctx->parameters.len, c->x, c->y, att, ctx);
+        if (sc >= SHAPE_OPEN_THREE) best_move_push(&moves, c->x, c->y, sc);
+    }
+    best_move_finish(&moves);
+
+    bool won = false;
+    for (int i = 0; i < moves.n && !won; ++i) {
+        make_move(ctx, best_move_x(&moves)[i], best_move_y(&moves)[i], att);
+        won = threat_defend(ctx, att, def, depth - 1, vct);
+        unmake_move(ctx);
+        if (won) {
+            *bx = best_move_x(&moves)[i];
+            *by = best_move_y(&moves)[i];
+        }
+        if (threat_stopped(ctx)) break;
+    }
+    best_move_free(&moves);
+
+    //  -   
+    if (won || !threat_stopped(ctx)) {
+        e->key = key;
+        e->depth = depth;
+        e->won = won;
+        e->move_x = won ? *bx : 0;
+        e->move_y = won ? *by : 0;
+    }
+    return won;
+}
+
+/*   :    ,   -
+ ,     ,   ;  ,      */
+bool threat_defend(GameContext* ctx, char att, char def, short depth, bool vct) {
+    long long sx = 0, sy = 0;
+    if (winning_spots(ctx, def, &sx, &sy)) return false;
+    int spots = winning_spots(ctx, att, &sx, &sy);
+    if (spots >= 2) return true;
+    if (spots == 1) {
+        make_move(ctx, sx, sy, def);
+        bool won = threat_attack(ctx, att, def, depth, vct, &sx, &sy);
+        unmake_move(ctx);
+        return won;
+    }
+    if (!vct) return false;
+
+    best_move replies;
+    best_move_init(&replies, MOVES_INLINE);
+    for (int i = 0; i < ctx->cands.n; ++i) {
+        CandSlot* c = &ctx->cands.slots[ctx->cands.list[i]];
+        int sc = line_score(ctx->board, ctx->parameters.size, ctx->parameters.len, c->x, c->y, att, ctx);
+        if (sc >= SHAPE_FOUR || makes_four(ctx, c->x, c->y, def)) best_move_push(&replies, c->x, c->y, sc);
+    }
+    best_move_finish(&replies);
+    //  ,    , -    
+    bool won = replies.n > 0 && replies.n < MOVES_INLINE;
+    for (int i = 0; i < replies.n && won; ++i) {
+        make_move(ctx, best_move_x(&replies)[i], best_move_y(&replies)[i], def);
+        won = threat_attack(ctx, att, def, depth, vct, &sx, &sy);
+        unmake_move(ctx);
+    }
+    best_move_free(&replies);
+    return won;
+}
+
+//    
+typedef enum {
+    THREAT_WON,     //  
+    THREAT_NONE,    //   ,  
+    THREAT_UNKNOWN, //      ,  
+    THREAT_PAUSED   //  ,   
+} threat_result;
+
+//   :       ,   
+typedef struct {
+    char att;
+    short d;
+    bool vct;
+    unsigned long long nodes, limit;
+} ThreatRun;
+
+void threat_run_init(ThreatRun* run, char att, unsigned long long limit) {
+    run->att = att;
+    run->d = 1;
+    run->vct = false;
+    run->nodes = 0;
+    run->limit = limit;
+}
+
+/*    att,    ,  :  ,   
+ ,     ; (bx, by) -   
+   ,         
+  pause (0 -  )  ;         */
+threat_result threat_run(GameContext* ctx, ThreatRun* run, long long pause, long long* bx, long long* by) {
+    char att = run->att;
+    char def = att == ctx->parameters.ai ? ctx->parameters.player : ctx->parameters.ai;
+    ctx->threat_nodes = run->nodes;
+    ctx->threat_limit = run->limit;
+    ctx->threat_pause = pause;
+    ctx->threat_paused = false;
+    threat_result r = THREAT_NONE;
+    while (!threat_stopped(ctx)) {
+        if (run->d > (run->vct ? VCT_DEPTH : VCF_DEPTH)) {
+            if (run->vct || !ctx->patterns) break;
+            run->vct = true;
+            run->d = 1;
+            continue;
+        }
+        if (threat_attack(ctx, att, def, run->d, run->vct, bx, by)) {
+            r = THREAT_WON;
+            break;
+        }
+        if (!threat_stopped(ctx)) run->d++;
+    }
+    run->nodes = ctx->threat_nodes;
+    if (r == THREAT_WON || !threat_stopped(ctx)) return r;
+    if (ctx->threat_paused && !ctx->search_abort && ctx->threat_nodes <= ctx->threat_limit) return THREAT_PAUSED;
+    return THREAT_UNKNOWN;
+}
+
+/*    :   ,     
+ slots        ,     :
+    ,          */
+typedef struct {
+    best_move* moves;
+    best_move* slots; //     ,     -    ; NULL -  
+    TransTable* tt;   //  
+    short depth;
+    int lo, hi;
+    bool pvs;
+    int next;  //     
+    int alpha; //     ,   PVS  
+    int val;   //   
+    int best;  //    moves, -1 -  
+    bool cut;  //    hi,    
+    int batch_end; //  slots:   batch_end    alpha
+    int running;   //  slots:    
+} RootJob;
+
+#ifndef NO_THREADS
+/*      :    ,
+     ,   ,   */
+typedef struct {
+    mtx_t lock;
+    SplitPoint* items[MAX_PLY];
+    int count;
+} SplitDeque;
+
+/*  :        ,    ,
+    */
+typedef struct SearchPool {
+    int n; //  ,    
+    thrd_t* threads;
+    GameContext* workers;
+    mtx_t lock;
+    cnd_t wake, done, work;
+    cnd_t batch;       // ROOT_SPLIT:     
+    unsigned int task; //  ,    
+    int busy;          // ,   
+    bool quit;
+    int mode;          // ROOT_SPLIT -    job, LAZY_SMP  YBWC -    stop
+    atomic_bool stop;
+    RootJob job;
+    SplitDeque* deques; // n + 1   ,    slot
+    unsigned int splits; //    ,     
+    int idle;            //  YBWC,    
+} SearchPool;
+#endif
+
+/*       ;   -   ,   -   
+ slots  alpha    :      ,    1,
+     
+ slots     ROOT_BATCH: alpha  -     ,  
+,     ,   hi -     ;
+           */
+//        ; -1,    , ROOT_WAIT -   
+int root_take(RootJob* job, int* alpha) {
+    if (job->slots) {
+        if (job->next >= job->batch_end) {
+            if (job->running > 0) return ROOT_WAIT;
+            if (job->cut || job->next >= job->moves->n) return -1;
+            if (job->val > job->alpha) job->alpha = job->val;
+            job->batch_end = job->next + ROOT_BATCH;
+            if (job->batch_end > job->moves->n) job->batch_end = job->moves->n;
+        }
+        job->running++;
+        *alpha = job->alpha;
+        return job->next++;
+    }
+    if (job->cut || job->next >= job->moves->n) return -1;
+    int i = job->next++;
+    *alpha = job->alpha;
+    if (i < job->best && *alpha > INT_MIN) (*alpha)--;
+    return i;
+}
+
+//  val  i   
+void root_merge(RootJob* job, int i, int val) {
+    if (val > job->val || (val == job->val && i < job->best)) {
+        job->val = val;
+        job->best = i;
+    }
+    if (job->slots) {
+        job->running--;
+        if (val >= job->hi) job->cut = true;
+        return;
+    }
+    if (val > job->alpha) job->alpha = val;
+    if (job->alpha >= job->hi) job->cut = true;
+}
+
+//    tt   part  parts:    
+TransTable* tt_part(GameContext* w, TransTable* tt, int part, int parts) {
+    unsigned long long size = 1;
+    while (size * 2 * parts <= tt->mask + 1) size <<= 1;
+    w->tt_part.buckets = tt->buckets + part * size;
+    w->tt_part.mask = size - 1;
+    w->tt_part.mb = tt->mb;
+    w->tt_part.generation = tt->generation;
+    return &w->tt_part;
+}
+
+/*  i     w;  slots      
+     ,           */
+void root_enter(GameContext* w, RootJob* job, int i) {
+    long long x = best_move_x(job->moves)[i], y = best_move_y(job->moves)[i];
+    if (job->slots) {
+        int part = 0;
+        while (best_move_x(job->slots)[part] != x || best_move_y(job->slots)[part] != y) part++;
+        reset_move_order(w);
+        w->tt = tt_part(w, job->tt, part, job->slots->n);
+    }
+    make_move(w, x, y, w->parameters.ai);
+}
+
+void root_leave(GameContext* w, RootJob* job) {
+    unmake_move(w);
+    w->tt = job->tt;
+}
+
+//    i    alpha
+int root_move(GameContext* w, RootJob* job, int i, int alpha) {
+    base* p = &w->parameters;
+    root_enter(w, job, i);
+    int val;
+    if (!job->pvs) val = minimax(w->board, p, &w->bbox, false, alpha, job->hi, job->depth, w);
+    else {
+        val = minimax(w->board, p, &w->bbox, false, alpha, alpha + 1, job->depth, w);
+        if (val > alpha && val < job->hi) val = minimax(w->board, p, &w->bbox, false, alpha, job->hi, job->depth, w);
+    }
+    root_leave(w, job);
+    return val;
+}
+
+#ifndef NO_THREADS
+//   ,   ; pool - NULL,   
+void root_work(GameContext* w, RootJob* job, SearchPool* pool) {
+    if (pool) mtx_lock(&pool->lock);
+    for (;;) {
+        int alpha;
+        int i = root_take(job, &alpha);
+        if (i == ROOT_WAIT) {
+            cnd_wait(&pool->batch, &pool->lock);
+            continue;
+        }
+        if (i < 0) break;
+        if (pool) mtx_unlock(&pool->lock);
+
+        int val = root_move(w, job, i, alpha);
+
+        if (pool) mtx_lock(&pool->lock);
+        if (w->search_abort) {
+            //  :    ,   
+            job->running--;
+            job->cut = true;
+            if (pool) cnd_broadcast(&pool->batch);
+            break;
+        }
+        root_merge(job, i, val);
+        if (pool && job->running == 0) cnd_broadcast(&pool->batch);
+    }
+    if (pool) mtx_unlock(&pool->lock);
+}
+
+/*  Lazy SMP:      ,    ,
+      ,  ,  -    (    1),
+        ,
+         
+   ,  ,      stop*/
+void lazy_work(GameContext* w, int index, short depth) {
+    base* p = &w->parameters;
+    best_move tk;
+    generate_candidates(w->board, p, &w->bbox, true, 32, &tk, w);
+    int last = depth + (index & 1);
+    for (int d = index & 1; d <= last && !w->search_abort; ++d) {
+        int alpha = INT_MIN;
+        for (int k = 0; k < tk.n && !w->search_abort; ++k) {
+            int i = (k + index) % tk.n;
+            make_move(w, best_move_x(&tk)[i], best_move_y(&tk)[i], p->ai);
+            int val = minimax(w->board, p, &w->bbox, false, alpha, INT_MAX, d, w);
+            unmake_move(w);
+            if (!w->search_abort && val > alpha) alpha = val;
+        }
+    }
+    best_move_free(&tk);
+}
+
+//       
+void pool_cancel(SearchPool* pool) {
+    atomic_store_explicit(&pool->stop, true, memory_order_relaxed);
+}
+
+//      :    YBWC,        
+bool split_ok(GameContext* ctx, short depth, int n) {
+    //          ,   
+    if (!ctx->pool || ctx->pool->mode != YBWC || ctx->null_move) return false;
+    if (depth < SPLIT_MIN_DEPTH || n < 3 || ctx->undo_top >= MAX_PLY) return false;
+    return !search_stopped(ctx);
+}
+
+/*     ,      
+   -  alpha  beta ,       */
+void split_work(GameContext* w, SplitPoint* sp) {
+    for (;;) {
+        mtx_lock(&sp->lock);
+        if (atomic_load_explicit(&sp->cut, memory_order_relaxed) || sp->next >= sp->moves->n) {
+            mtx_unlock(&sp->lock);
+            return;
+        }
+        int i = sp->next++;
+        int alpha = sp->alpha, beta = sp->beta;
+        mtx_unlock(&sp->lock);
+
+        long long x = best_move_x(sp->moves)[i], y = best_move_y(sp->moves)[i];
+        int val = child_value(w, sp->isMax, alpha, beta, sp->depth, i, x, y);
+        if (search_stopped(w)) {
+            if (w->search_abort) {
+                mtx_lock(&sp->lock);
+                sp->aborted = true;
+                mtx_unlock(&sp->lock);
+            }
+            return;
+        }
+
+        mtx_lock(&sp->lock);
+        if (sp->isMax ? val > sp->best : val < sp->best) {
+            sp->best = val;
+            sp->best_x = x;
+            sp->best_y = y;
+        }
+        if (sp->isMax && sp->best > sp->alpha) sp->alpha = sp->best;
+        if (!sp->isMax && sp->best < sp->beta) sp->beta = sp->best;
+        if (sp->alpha >= sp->beta) atomic_store_explicit(&sp->cut, true, memory_order_relaxed);
+        mtx_unlock(&sp->lock);
+    }
+}
+
+/*YBWC:    ,      
+      ,     ,   ,
+  ;    *alpha, *beta, *best,    */
+void split_search(GameContext* ctx, best_move* moves, bool isMax, int* alpha, int* beta, short depth,
+    int* best, long long* best_x, long long* best_y) {
+    SearchPool* pool = ctx->pool;
+    SplitPoint sp;
+    mtx_init(&sp.lock, mtx_plain);
+    cnd_init(&sp.done);
+    sp.parent = ctx->split;
+    sp.moves = moves;
+    for (int k = 0; k < ctx->undo_top; ++k) {
+        sp.path_x[k] = ctx->undo[k].x;
+        sp.path_y[k] = ctx->undo[k].y;
+        sp.path_value[k] = ctx->undo[k].value;
+    }
+    sp.path_len = ctx->undo_top;
+    sp.isMax = isMax;
+    sp.depth = depth;
+    sp.next = 1;
+    sp.alpha = *alpha;
+    sp.beta = *beta;
+    sp.best = *best;
+    sp.best_x = *best_x;
+    sp.best_y = *best_y;
+    sp.helpers = 0;
+    sp.aborted = false;
+    atomic_init(&sp.cut, false);
+
+    SplitDeque* dq = &pool->deques[ctx->slot];
+    mtx_lock(&dq->lock);
+    dq->items[dq->count++] = &sp;
+    mtx_unlock(&dq->lock);
+    mtx_lock(&pool->lock);
+    pool->splits++;
+    if (pool->idle) cnd_broadcast(&pool->work);
+    mtx_unlock(&pool->lock);
+
+    ctx->split = &sp;
+    split_work(ctx, &sp);
+    //        ,   ,   
+    mtx_lock(&dq->lock);
+    dq->count--;
+    mtx_unlock(&dq->lock);
+    mtx_lock(&sp.lock);
+    while (sp.helpers > 0) cnd_wait(&sp.done, &sp.lock);
+    mtx_unlock(&sp.lock);
+    ctx->split = sp.parent;
+
+    if (sp.aborted) ctx->search_abort = true;
+    *alpha = sp.alpha;
+    *beta = sp.beta;
+    *best = sp.best;
+    *best_x = sp.best_x;
+    *best_y = sp.best_y;
+    if (atomic_load_explicit(&sp.cut, memory_order_relaxed) && !search_stopped(ctx)) {
+        note_cutoff(ctx, side_index(isMax ? ctx->parameters.ai : ctx->parameters.player), sp.best_x, sp.best_y, depth);
+    }
+    mtx_destroy(&sp.lock);
+    cnd_destroy(&sp.done);
+}
+
+/* :     ,    
+   ,     ,    */
+SplitPoint* steal_split(SearchPool* pool, int slot) {
+    for (int k = 1; k <= pool->n; ++k) {
+        SplitDeque* dq = &pool->deques[(slot + k) % (pool->n + 1)];
+        mtx_lock(&dq->lock);
+        for (int j = 0; j < dq->count; ++j) {
+            SplitPoint* sp = dq->items[j];
+            mtx_lock(&sp->lock);
+            bool open = !atomic_load_explicit(&sp->cut, memory_order_relaxed) && sp->next < sp->moves->n;
+            if (open) sp->helpers++;
+            mtx_unlock(&sp->lock);
+            if (open) {
+                mtx_unlock(&dq->lock);
+                return sp;
+            }
+        }
+        mtx_unlock(&dq->lock);
+    }
+    return NULL;
+}
+
+//    :        ,     
+void help_split(GameContext* w, SplitPoint* sp) {
+    for (int k = 0; k < sp->path_len; ++k) make_move(w, sp->path_x[k], sp->path_y[k], sp->path_value[k]);
+    w->split = sp;
+    split_work(w, sp);
+    w->split = NULL;
+    for (int k = 0; k < sp->path_len; ++k) unmake_move(w);
+    mtx_lock(&sp->lock);
+    if (--sp->helpers == 0) cnd_signal(&sp->done);
+    mtx_unlock(&sp->lock);
+}
+
+//   YBWC:    ,      stop
+void ybwc_work(GameContext* w) {
+    SearchPool* pool = w->pool;
+    mtx_lock(&pool->lock);
+    unsigned int seen = pool->splits;
+    mtx_unlock(&pool->lock);
+    while (!atomic_load(&pool->stop)) {
+        SplitPoint* sp = steal_split(pool, w->slot);
+        if (sp) {
+            help_split(w, sp);
+            continue;
+        }
+        mtx_lock(&pool->lock);
+        pool->idle++;
+        while (!atomic_load(&pool->stop) && pool->splits == seen) cnd_wait(&pool->work, &pool->lock);
+        pool->idle--;
+        seen = pool->splits;
+        mtx_unlock(&pool->lock);
+    }
+}
+
+int search_thread(void* arg) {
+    GameContext* w = (GameContext*)arg;
+    SearchPool* pool = w->pool;
+    unsigned int seen = 0;
+    mtx_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->task == seen) cnd_wait(&pool->wake, &pool->lock);
+        if (pool->quit) break;
+        seen = pool->task;
+        mtx_unlock(&pool->lock);
+        if (pool->mode == LAZY_SMP) lazy_work(w, w->slot, pool->job.depth);
+        else if (pool->mode == YBWC) ybwc_work(w);
+        else root_work(w, &pool->job, pool);
+        mtx_lock(&pool->lock);
+        if (--pool->busy == 0) cnd_signal(&pool->done);
+    }
+    mtx_unlock(&pool->lock);
+    return 0;
+}
+
+//   n  
+SearchPool* create_pool(int n) {
+    SearchPool* pool = (SearchPool*)calloc(1, sizeof(SearchPool));
+    if (!pool) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+    pool->threads = (thrd_t*)malloc(n * sizeof(thrd_t));
+    pool->workers = (GameContext*)calloc(n, sizeof(GameContext));
+    pool->deques = (SplitDeque*)calloc(n + 1, sizeof(SplitDeque));
+    if (!pool->threads || !pool->workers || !pool->deques) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+    mtx_init(&pool->lock, mtx_plain);
+    cnd_init(&pool->wake);
+    cnd_init(&pool->done);
+    cnd_init(&pool->work);
+    cnd_init(&pool->batch);
+    atomic_init(&pool->stop, false);
+    for (int i = 0; i <= n; ++i) mtx_init(&pool->deques[i].lock, mtx_plain);
+    for (int i = 0; i < n; ++i) {
+        GameContext* w = &pool->workers[i];
+        w->board = create_table(1024);
+        w->undo_capacity = 64;
+        w->undo = (UndoEntry*)malloc(w->undo_capacity * sizeof(UndoEntry));
+        if (!w->undo) {
+            printf("Memory allocation error\n");
+            exit(1);
+        }
+        cand_init(&w->cands, 1024);
+        w->pool = pool;
+        w->stop = &pool->stop;
+        w->slot = i + 1;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (thrd_create(&pool->threads[i], search_thread, &pool->workers[i]) != thrd_success) {
+            printf("Thread creation error\n");
+            exit(1);
+        }
+        pool->n++;
+    }
+    return pool;
+}
+
+void free_pool(SearchPool* pool) {
+    mtx_lock(&pool->lock);
+    pool->quit = true;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+    for (int i = 0; i < pool->n; ++i) {
+        thrd_join(pool->threads[i], NULL);
+        GameContext* w = &pool->workers[i];
+        free_table(w->board);
+        free(w->undo);
+        cand_free(&w->cands);
+    }
+    mtx_destroy(&pool->lock);
+    cnd_destroy(&pool->wake);
+    cnd_destroy(&pool->done);
+    cnd_destroy(&pool->work);
+    cnd_destroy(&pool->batch);
+    for (int i = 0; i <= pool->n; ++i) mtx_destroy(&pool->deques[i].lock);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
+
+/*       
+  ,        */
+void pool_sync(GameContext* ctx) {
+    SearchPool* pool = ctx->pool;
+    for (int i = 0; i < pool->n; ++i) {
+        GameContext* w = &pool->workers[i];
+        w->parameters = ctx->parameters;
+        w->bbox = ctx->bbox;
+        copy_table(w->board, ctx->board);
+        memcpy(w->threats, ctx->threats, sizeof(ctx->threats));
+        w->patterns = ctx->patterns;
+        w->pattern_len = ctx->pattern_len;
+        cand_rebuild(w);
+        w->undo_top = 0;
+        w->tt = ctx->tt; // reset_tt    
+        reset_move_order(w);
+        w->search_deadline = ctx->search_deadline;
+        w->search_abort = false;
+        w->search_nodes = 0;
+        w->null_move = false;
+        w->split = NULL;
+    }
+}
+#endif
+
+/*     depth   (lo, hi):       alpha,
+     ,   ;     ctx->search_abort*/
+//   ,     ; slots - NULL    , tt -  
+void root_begin(RootJob* job, best_move* moves, best_move* slots, TransTable* tt, short depth, int lo, int hi, bool pvs) {
+    job->moves = moves;
+    job->slots = slots;
+    job->tt = tt;
+    job->depth = depth;
+    job->lo = lo;
+    job->hi = hi;
+    job->pvs = pvs;
+    job->best = -1;
+}
+
+//      (lo, hi)   alpha  
+void root_first(RootJob* job, int val) {
+    job->next = 1;
+    job->val = val;
+    job->best = 0;
+    job->alpha = val > job->lo ? val : job->lo;
+    job->cut = val >= job->hi;
+    job->batch_end = 1;
+    job->running = 0;
+}
+
+void root_search(GameContext* ctx, best_move* moves, best_move* slots, short depth, int lo, int hi, bool pvs, RootJob* job) {
+    base* p = &ctx->parameters;
+    root_begin(job, moves, slots, ctx->tt, depth, lo, hi, pvs);
+    if (moves->n == 0) return;
+
+    root_enter(ctx, job, 0);
+    int val = minimax(ctx->board, p, &ctx->bbox, false, pvs ? lo : INT_MIN, pvs ? hi : INT_MAX, depth, ctx);
+    root_leave(ctx, job);
+    root_first(job, val);
+    if (ctx->search_abort || job->cut) return;
+
+#ifdef NO_THREADS
+    int alpha;
+    for (int i = root_take(job, &alpha); i >= 0; i = root_take(job, &alpha)) {
+        val = root_move(ctx, job, i, alpha);
+        if (ctx->search_abort) return;
+        root_merge(job, i, val);
+    }
+#else
+    SearchPool* pool = ctx->pool;
+    if (!pool || pool->mode != ROOT_SPLIT) {
+        root_work(ctx, job, NULL);
+        return;
+    }
+    mtx_lock(&pool->lock);
+    atomic_store(&pool->stop, false);
+    pool->job = *job;
+    pool->busy = pool->n;
+    pool->task++;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+    root_work(ctx, &pool->job, pool);
+    mtx_lock(&pool->lock);
+    while (pool->busy > 0) cnd_wait(&pool->done, &pool->lock);
+    *job = pool->job;
+    mtx_unlock(&pool->lock);
+    for (int i = 0; i < pool->n; ++i) {
+        GameContext* w = &pool->workers[i];
+        if (w->search_abort) ctx->search_abort = true;
+        ctx->search_nodes += w->search_nodes;
+        w->search_nodes = 0;
+    }
+#endif
+}
+
+#ifndef NO_THREADS
+//      LAZY_SMP  YBWC       depth
+void pool_start(GameContext* ctx, int mode, short depth) {
+    SearchPool* pool = ctx->pool;
+    mtx_lock(&pool->lock);
+    pool->mode = mode;
+    pool->job.depth = depth;
+    atomic_store(&pool->stop, false);
+    pool->busy = pool->n;
+    pool->task++;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+}
+
+//   ,      
+void pool_stop(GameContext* ctx) {
+    SearchPool* pool = ctx->pool;
+    atomic_store(&pool->stop, true);
+    mtx_lock(&pool->lock);
+    cnd_broadcast(&pool->work);
+    while (pool->busy > 0) cnd_wait(&pool->done, &pool->lock);
+    pool->mode = ROOT_SPLIT;
+    mtx_unlock(&pool->lock);
+    for (int i = 0; i < pool->n; ++i) {
+        ctx->search_nodes += pool->workers[i].search_nodes;
+        pool->workers[i].search_nodes = 0;
+    }
+}
+#endif
+
+//  :       ,     
+typedef enum {
+    PREP_OWN_THREATS,    //    
+    PREP_PLAYER_THREATS, //    
+    PREP_FILTER,         //  :      
+    PREP_READY,          //   
+    PREP_MOVED           //   ,   
+} prep_stage;
+
+//  ,   :  ,      
+typedef struct {
+    best_move moves;
+    best_move slots; // moves  ,          
+    short depth; //    
+    bool pvs;
+    bool found;
+    int bestVal;
+    long long bestX, bestY;
+    unsigned long long key;
+    long long start;
+    int helpers;
+    int mode;
+    bool sliced; //      
+    prep_stage prep;
+    bool threats;       //        
+    long long prep_end; //   now_ms,      , 0 -  
+    ThreatRun run;
+    best_move all;      //  :  
+    best_move unsure;   //  ,       
+    int check;          //  
+    bool checking;      //   check ,    
+    unsigned long long spent; //   
+    int safe, unchecked;
+} RootState;
+
+/*  :      
+true,    ;    root_prepare_step*/
+bool root_prepare_start(GameContext* ctx, RootState* rs) {
+    Table* board = ctx->board;
+    base* parameters = &ctx->parameters;
+    bounds* bbox = &ctx->bbox;
+    long long bx, by;
+    if (find_immediate_move(board, parameters, bbox, true, &bx, &by, ctx)) {
+        play_move(ctx, bx, by, parameters->ai);
+        return true;
+    }
+    if (find_immediate_move(board, parameters, bbox, false, &bx, &by, ctx)) {
+        play_move(ctx, bx, by, parameters->ai);
+        return true;
+    }
+
+    if (parameters->len == 3 && parameters->size > 4 && parameters->difficulty > 2) {
+        if (find_adjacent_move(board, parameters, bbox, &bx, &by, ctx)) {
+            play_move(ctx, bx, by, parameters->ai);
+            return true;
+        }
+    }
+
+    //      ,     time_budget_ms
+    long long start = now_ms();
+    rs->start = start;
+    ctx->search_deadline = parameters->time_budget_ms ? start + parameters->time_budget_ms : 0;
+    ctx->search_abort = false;
+    ctx->search_nodes = 0;
+    ctx->search_depth = 0;
+
+    /*       ,    
+         ,    */
+    rs->threats = parameters->len >= 5;
+    rs->prep_end = parameters->time_budget_ms ? start + parameters->time_budget_ms / PREP_SHARE : 0;
+    threat_run_init(&rs->run, parameters->ai, THREAT_NODES);
+    rs->prep = PREP_OWN_THREATS;
+    return false;
+}
+
+//   :   pause (0 -  )      ,  
+long long prep_pause(RootState* rs, long long pause) {
+    if (!pause || (rs->prep_end && rs->prep_end < pause)) return rs->prep_end;
+    return pause;
+}
+
+//     
+bool prep_over(RootState* rs) {
+    return rs->prep_end && now_ms() >= rs->prep_end;
+}
+
+/* ,    : true,  ; false -   pause
+     FILTER_NODES     prep_end; ,  
+    ,       */
+bool root_filter_step(GameContext* ctx, RootState* rs, long long pause) {
+    base* parameters = &ctx->parameters;
+    best_move* tk = &rs->moves;
+    while (rs->check < rs->all.n) {
+        int i = rs->check;
+        threat_result r = THREAT_UNKNOWN;
+        if (!rs->checking && rs->spent < FILTER_NODES && !ctx->search_abort && !prep_over(rs)) {
+            make_move(ctx, best_move_x(&rs->all)[i], best_move_y(&rs->all)[i], parameters->ai);
+            unsigned long long left = FILTER_NODES - rs->spent;
+            threat_run_init(&rs->run, parameters->player, left < THREAT_NODES ? left : THREAT_NODES);
+            rs->checking = true;
+        }
+        if (rs->checking) {
+            long long px, py;
+            r = threat_run(ctx, &rs->run, prep_pause(rs, pause), &px, &py);
+            if (r == THREAT_PAUSED && !prep_over(rs)) return false;
+            unmake_move(ctx);
+            rs->checking = false;
+            rs->spent += rs->run.nodes;
+        }
+        if (r == THREAT_NONE) {
+            best_move_push(tk, best_move_x(&rs->all)[i], best_move_y(&rs->all)[i], best_move_score(&rs->all)[i]);
+            rs->safe++;
+        }
+        else if (r != THREAT_WON) {
+            best_move_push(&rs->unsure, best_move_x(&rs->all)[i], best_move_y(&rs->all)[i], best_move_score(&rs->all)[i]);
+            rs->unchecked++;
+        }
+        rs->check++;
+        if (pause && rs->check < rs->all.n && now_ms() >= pause) return false;
+    }
+    best_move_finish(tk);
+    best_move_finish(&rs->unsure);
+    for (int i = 0; i < rs->unsure.n && tk->n < tk->cap; ++i) {
+        best_move_set(tk, tk->n++, best_move_x(&rs->unsure)[i], best_move_y(&rs->unsure)[i], best_move_score(&rs->unsure)[i]);
+    }
+    if (AI_DEBUG) {
+        printf("AI threat search: player threatens a forced win, %d of %d moves hold, %d unchecked, %llu nodes\n",
+            rs->safe, rs->all.n, rs->unchecked, rs->spent);
+    }
+    best_move_free(&rs->all);
+    //    ,    
+    if (tk->n == 0) generate_candidates(ctx->board, parameters, &ctx->bbox, true, 32, tk, ctx);
+    return true;
+}
+
+/*      ;   pause (0 -  )  
+       .  PREP_MOVED,    ,
+PREP_READY,    ,  - ,    */
+prep_stage root_prepare_step(GameContext* ctx, RootState* rs, long long pause) {
+    Table* board = ctx->board;
+    base* parameters = &ctx->parameters;
+    bounds* bbox = &ctx->bbox;
+    long long bx, by;
+    for (;;) {
+        switch (rs->prep) {
+        case PREP_OWN_THREATS: {
+            threat_result r = rs->threats ? threat_run(ctx, &rs->run, prep_pause(rs, pause), &bx, &by) : THREAT_NONE;
+            if (r == THREAT_PAUSED && !prep_over(rs)) return rs->prep;
+            if (r == THREAT_WON) {
+                if (AI_DEBUG) printf("AI threat search: forced win, %llu nodes\n", rs->run.nodes);
+                play_move(ctx, bx, by, parameters->ai);
+                rs->prep = PREP_MOVED;
+                break;
+            }
+            rs->bestVal = INT_MIN;
+            rs->bestX = rs->bestY = 0;
+            rs->found = false; // -1     
+            generate_candidates(board, parameters, bbox, true, 32, &rs->moves, ctx);
+            threat_run_init(&rs->run, parameters->player, THREAT_NODES);
+            rs->prep = PREP_PLAYER_THREATS;
+            break;
+        }
+        case PREP_PLAYER_THREATS: {
+            threat_result r = rs->threats ? threat_run(ctx, &rs->run, prep_pause(rs, pause), &bx, &by) : THREAT_NONE;
+            if (r == THREAT_PAUSED && !prep_over(rs)) return rs->prep;
+            if (r != THREAT_WON) {
+                rs->prep = PREP_READY;
+                break;
+            }
+            /*   :     ,    
+               -     generate_candidates  */
+            generate_candidates(board, parameters, bbox, true, ctx->cands.n, &rs->all, ctx);
+            best_move_init(&rs->moves, 32);
+            best_move_init(&rs->unsure, 32);
+            rs->check = 0;
+            rs->checking = false;
+            rs->spent = 0;
+            rs->safe = rs->unchecked = 0;
+            rs->prep = PREP_FILTER;
+            break;
+        }
+        case PREP_FILTER:
+            if (!root_filter_step(ctx, rs, pause)) return rs->prep;
+            rs->prep = PREP_READY;
+            break;
+        case PREP_READY:
+        case PREP_MOVED:
+            return rs->prep;
+        }
+    }
+}
+
+//  :  ,     ; threads -    
+void root_prepare_finish(GameContext* ctx, RootState* rs, bool threads) {
+    base* parameters = &ctx->parameters;
+    int depth = 2;
+    if (ctx->parameters.difficulty == 4) depth = 5;
+    //   ,          
+    if (ctx->parameters.difficulty == 4 && (parameters->use_lmr || parameters->use_null_move)) depth += 2;
+    if (ctx->parameters.difficulty == 3) depth = 3; //     quiesce
+    if (ctx->parameters.difficulty == 2) depth = 3;
+
+    if (parameters->infinite_field == 0 && parameters->size == 3) depth += 2;
+    else if (parameters->infinite_field == 0 && parameters->size == 4) depth++;
+
+    //     ,      
+    ctx->tt->generation++;
+    reset_move_order(ctx);
+    rs->key = tt_key(ctx->board, true);
+
+    int helpers = 0;
+#ifndef NO_THREADS
+    //            
+    helpers = threads && parameters->search_threads > 1 ? parameters->search_threads - 1 : 0;
+    if (ctx->pool && ctx->pool->n != helpers) {
+        free_pool(ctx->pool);
+        ctx->pool = NULL;
+    }
+    if (helpers && !ctx->pool) ctx->pool = create_pool(helpers);
+    if (ctx->pool) pool_sync(ctx);
+#endif
+    rs->helpers = helpers;
+    rs->mode = helpers ? parameters->parallel_mode : ROOT_SPLIT;
+#ifndef NO_THREADS
+    if (rs->mode != ROOT_SPLIT) pool_start(ctx, rs->mode, depth);
+#endif
+    rs->depth = depth;
+    rs->pvs = parameters->search_mode == PVS;
+    rs->sliced = !threads;
+    /*    :   -       
+        32, slots         */
+    best_move_init(&rs->slots, rs->moves.n);
+    for (int i = 0; i < rs->moves.n; ++i) {
+        best_move_set(&rs->slots, i, best_move_x(&rs->moves)[i], best_move_y(&rs->moves)[i], best_move_score(&rs->moves)[i]);
+    }
+    rs->slots.n = rs->moves.n;
+}
+
+//        ,         
+best_move* root_slots(RootState* rs) {
+    return rs->mode == ROOT_SPLIT ? &rs->slots : NULL;
+}
+
+//        
+void root_order(RootState* rs) {
+    if (rs->found) best_move_to_front(&rs->moves, rs->bestX, rs->bestY);
+}
+
+/*   :  ,  ,      
+true,        ; threads -     */
+bool root_prepare(GameContext* ctx, RootState* rs, bool threads) {
+    if (root_prepare_start(ctx, rs)) return true;
+    if (root_prepare_step(ctx, rs, 0) == PREP_MOVED) return true;
+    root_prepare_finish(ctx, rs, threads);
+    return false;
+}
+
+//  :   PVS -   ,         
+void root_window(RootState* rs, int* lo, int* hi) {
+    *lo = INT_MIN;
+    *hi = INT_MAX;
+    if (rs->pvs && rs->found) {
+        *lo = rs->bestVal - ASPIRATION_WINDOW;
+        *hi = rs->bestVal + ASPIRATION_WINDOW;
+    }
+}
+
+//     ,   
+bool root_window_failed(RootJob* job) {
+    return (job->lo != INT_MIN && job->val <= job->lo) || (job->hi != INT_MAX && job->val >= job->hi);
+}
+
+//   d ; true,    
+bool root_iteration_done(GameContext* ctx, RootState* rs, RootJob* job, int d) {
+    rs->found = job->best >= 0;
+    if (!rs->found) return true;
+    rs->bestVal = job->val;
+    rs->bestX = best_move_x(&rs->moves)[job->best];
+    rs->bestY = best_move_y(&rs->moves)[job->best];
+    ctx->search_depth = d + 1;
+    tt_store(ctx->tt, rs->key, d + 1, rs->bestVal, TT_EXACT, true, rs->bestX, rs->bestY);
+    return rs->bestVal > 50000 || rs->bestVal < -50000; //     
+}
+
+//  :        
+void root_finish(GameContext* ctx, RootState* rs) {
+#ifndef NO_THREADS
+    if (rs->mode != ROOT_SPLIT) pool_stop(ctx);
+#endif
+    if (AI_DEBUG) {
+        printf("AI search (%s, %d threads%s): depth %d, %llu nodes, %lld ms\n", rs->pvs ? "pvs" : "alpha-beta", rs->helpers + 1,
+            rs->mode == LAZY_SMP ? ", lazy smp" : (rs->mode == YBWC ? ", ybwc" : (rs->sliced ? ", time-sliced" : "")),
+            ctx->search_depth, ctx->search_nodes, now_ms() - rs->start);
+    }
+    if (!rs->found && rs->moves.n > 0) {
+        //      -     
+        rs->bestX = best_move_x(&rs->moves)[0];
+        rs->bestY = best_move_y(&rs->moves)[0];
+        rs->found = true;
+    }
+    if (rs->found) {
+        play_move(ctx, rs->bestX, rs->bestY, ctx->parameters.ai);
+    }
+}
+
+void minimax_move(GameContext* ctx) {
+    RootState rs;
+    if (root_prepare(ctx, &rs, true)) return;
+
+    /* : depth   -  ,   time_budget_ms
+         */
+    for (int d = 0; d <= rs.depth; ++d) {
+        RootJob job;
+        int lo, hi;
+        root_window(&rs, &lo, &hi);
+        for (;;) {
+            root_order(&rs);
+            root_search(ctx, &rs.moves, root_slots(&rs), d, lo, hi, rs.pvs, &job);
+            if (ctx->search_abort) break;
+            if (root_window_failed(&job)) {
+                lo = INT_MIN;
+                hi = INT_MAX;
+                continue;
+            }
+            break;
         }
+        if (ctx->search_abort) break;
+        if (root_iteration_done(ctx, &rs, &job, d)) break;
     }
+    root_finish(ctx, &rs);
 }
 
-//   
-bool find_immediate_move(Table* board, base* parameters, bounds* bbox, bool forAI, long long* bx, long long* by, GameContext* ctx) {
-    best_move cand;
-    short K;
-    if (parameters->infinite_field == 1) {
-        K = 200;
-    }
-    else {
-        K = 64;
-    }
-    generate_candidates(board, parameters, bbox, forAI, K, &cand, ctx);
-    char me = forAI ? parameters->ai : parameters->player;
-    for (int i = 0; i < cand.n; ++i) {
-        long long x = cand.x[i], y = cand.y[i];
-        insert(board, x, y, me);
-        bool win = check_win(board, parameters->size, parameters->len, x, y, me, ctx);
-        remove_cell(board, x, y);
-        if (win) {
-            *bx = x;
-            *by = y;
-            return true;
-        }
+//     :   ,    
+typedef enum {
+    NODE_ENTER,       //      
+    NODE_NULL_MOVE,   //     
+    NODE_NEXT,        //   
+    NODE_REDUCED,     //    
+    NODE_NULL_WINDOW, //      
+    NODE_CHILD,       //    
+    NODE_LEAF,        //    quiesce
+    QUIET_ENTER,      //  quiesce     
+    QUIET_BLOCK,      //    
+    QUIET_NEXT,       //   
+    QUIET_CHILD       //   
+} node_stage;
+
+//     
+typedef enum {
+    ROOT_PREPARE,   //     
+    ROOT_ITERATION, //   
+    ROOT_ATTEMPT,   //     (lo, hi)
+    ROOT_FIRST,     //   
+    ROOT_NEXT,      //   
+    ROOT_CHECK,     //     
+    ROOT_MOVE,      //    
+    ROOT_DONE       //  ,  
+} root_stage;
+
+//   : ,    minimax  quiesce    
+typedef struct {
+    bool isMax;
+    int alpha, beta, alpha0, beta0;
+    short depth; //  quiesce -   
+    node_stage stage;
+    unsigned long long key;
+    TTEntry entry;
+    bool has_entry;
+    best_move moves;
+    int i; //  
+    int best;
+    long long best_x, best_y;
+} CoopFrame;
+
+/*      :      ,
+       COOP_SLICE_MS
+    ,      */
+typedef struct CoopSearch {
+    GameContext engine;
+    RootState root;
+    root_stage stage;
+    int d;            //   
+    RootJob job;
+    int lo, hi;       //    
+    int move;         //  ,   
+    int move_alpha;   //    
+    CoopFrame frames[MAX_PLY];
+    int top;          //   , 0 -  
+    int ret;          //    
+    long long until;  //   now_ms,    
+} CoopSearch;
+
+//    ,    minimax
+void coop_call(CoopSearch* cs, bool isMax, int alpha, int beta, short depth) {
+    if (cs->top == MAX_PLY) {
+        //    ,     
+        GameContext* ctx = &cs->engine;
+        cs->ret = quiesce(ctx->board, &ctx->parameters, &ctx->bbox, isMax, alpha, beta, QUIESCE_DEPTH, ctx);
+        return;
     }
-    return false;
+    CoopFrame* f = &cs->frames[cs->top++];
+    f->isMax = isMax;
+    f->alpha = alpha;
+    f->beta = beta;
+    f->depth = depth;
+    f->stage = NODE_ENTER;
 }
 
-//         
-bool find_adjacent_move(Table* board, base* parameters, bounds* bbox, long long* bx, long long* by, GameContext* ctx) {
-    if (parameters->last_pl_x == LLONG_MAX || parameters->last_pl_y == LLONG_MAX)
-        return false;
+//     quiesce
+void coop_quiet_call(CoopSearch* cs, bool isMax, int alpha, int beta, short qdepth) {
+    coop_call(cs, isMax, alpha, beta, qdepth);
+    if (cs->top > 0 && cs->frames[cs->top - 1].stage == NODE_ENTER) cs->frames[cs->top - 1].stage = QUIET_ENTER;
+}
 
-    //   8  
-    int directions[8][2] = { {-1,0}, {1,0}, {0,-1}, {0,1}, {-1,1}, {1,-1}, {1,1}, {-1,-1} };
+//  ,    
+void coop_return(CoopSearch* cs, int val) {
+    cs->top--;
+    cs->ret = val;
+}
 
-    for (int i = 0; i < 8; i++) {
-        long long nx = parameters->last_pl_x + directions[i][0];
-        long long ny = parameters->last_pl_y + directions[i][1];
+//    :      PVS   
+void coop_child_full(CoopSearch* cs, CoopFrame* f) {
+    if (f->i == 0 || cs->engine.parameters.search_mode != PVS) {
+        f->stage = NODE_CHILD;
+        coop_call(cs, !f->isMax, f->alpha, f->beta, f->depth - 1);
+    }
+    else {
+        f->stage = NODE_NULL_WINDOW;
+        if (f->isMax) coop_call(cs, false, f->alpha, f->alpha + 1, f->depth - 1);
+        else coop_call(cs, true, f->beta - 1, f->beta, f->depth - 1);
+    }
+}
 
-        // ,       (  )
-        if (parameters->infinite_field == 0 &&
-            (nx < 0 || nx >= parameters->size || ny < 0 || ny >= parameters->size)) {
-            continue;
-        }
+//   :  ,    
+void coop_child_done(CoopSearch* cs, CoopFrame* f, int val) {
+    GameContext* ctx = &cs->engine;
+    unmake_move(ctx);
+    long long x = best_move_x(&f->moves)[f->i], y = best_move_y(&f->moves)[f->i];
+    if (node_update(ctx, f->isMax, &f->alpha, &f->beta, f->depth, val, x, y, &f->best, &f->best_x, &f->best_y)) f->i = f->moves.n;
+    else f->i++;
+    f->stage = NODE_NEXT;
+}
 
-        // ,   
-        if (get_value(board, nx, ny, parameters->size, ctx) == '.') {
-            *bx = nx;
-            *by = ny;
-            return true;
-        }
+//        
+void coop_node_moves(CoopSearch* cs, CoopFrame* f) {
+    int val;
+    if (node_moves(&cs->engine, f->isMax, f->depth, f->has_entry ? &f->entry : NULL, &f->moves, &val)) {
+        coop_return(cs, val);
+        return;
     }
-    return false;
+    f->i = 0;
+    f->best = f->isMax ? INT_MIN : INT_MAX;
+    f->best_x = best_move_x(&f->moves)[0];
+    f->best_y = best_move_y(&f->moves)[0];
+    f->stage = NODE_NEXT;
 }
 
-
-// 
-int minimax(Table* board, base* parameters, bounds* bbox, bool isMax, int alpha, int beta, short depth, GameContext* ctx) {
-    if (parameters->last_ai_x != LLONG_MAX &&
-        check_win(board, parameters->size, parameters->len, parameters->last_ai_x, parameters->last_ai_y, parameters->ai, ctx)) {
-        return 100000 - (int)parameters->count_moves;
+//      :   ,   minimax   
+void coop_node_step(CoopSearch* cs) {
+    GameContext* ctx = &cs->engine;
+    base* p = &ctx->parameters;
+    CoopFrame* f = &cs->frames[cs->top - 1];
+    int val;
+    switch (f->stage) {
+    case NODE_ENTER: {
+        TTEntry* hit;
+        if (node_enter(ctx, &val)) {
+            coop_return(cs, val);
+            return;
+        }
+        if (f->depth <= 0) {
+            f->stage = NODE_LEAF;
+            coop_quiet_call(cs, f->isMax, f->alpha, f->beta, QUIESCE_DEPTH);
+            return;
+        }
+        if (node_probe(ctx, f->isMax, f->alpha, f->beta, f->depth, &val, &f->key, &f->entry, &hit)) {
+            coop_return(cs, val);
+            return;
+        }
+        f->has_entry = hit != NULL;
+        f->alpha0 = f->alpha;
+        f->beta0 = f->beta;
+        if (null_move_ok(ctx, f->isMax, f->alpha, f->beta, f->depth)) {
+            ctx->null_move = true;
+            f->stage = NODE_NULL_MOVE;
+            if (f->isMax) coop_call(cs, false, f->beta - 1, f->beta, f->depth - 1 - NULL_MOVE_R);
+            else coop_call(cs, true, f->alpha, f->alpha + 1, f->depth - 1 - NULL_MOVE_R);
+            return;
+        }
+        coop_node_moves(cs, f);
+        return;
     }
-    if (parameters->last_pl_x != LLONG_MAX &&
-        check_win(board, parameters->size, parameters->len, parameters->last_pl_x, parameters->last_pl_y, parameters->player, ctx)) {
-        return -100000 + (int)parameters->count_moves;
+    case NODE_NULL_MOVE:
+        ctx->null_move = false;
+        val = cs->ret;
+        if (null_cutoff(ctx, f->isMax, f->alpha, f->beta, &val)) {
+            coop_return(cs, val);
+            return;
+        }
+        coop_node_moves(cs, f);
+        return;
+    case NODE_NEXT: {
+        if (f->i >= f->moves.n) {
+            node_store(ctx, f->key, f->depth, f->best, f->alpha0, f->beta0, f->best_x, f->best_y);
+            coop_return(cs, f->best);
+            return;
+        }
+        long long x = best_move_x(&f->moves)[f->i], y = best_move_y(&f->moves)[f->i];
+        char me = f->isMax ? p->ai : p->player;
+        char opp = f->isMax ? p->player : p->ai;
+        bool reduce = lmr_ok(ctx, f->i, f->depth, x, y, me, opp);
+        make_move(ctx, x, y, me);
+        if (!reduce) {
+            coop_child_full(cs, f);
+            return;
+        }
+        f->stage = NODE_REDUCED;
+        if (f->isMax) coop_call(cs, false, f->alpha, f->alpha + 1, f->depth - 2);
+        else coop_call(cs, true, f->beta - 1, f->beta, f->depth - 2);
+        return;
     }
-    if (depth <= 0) return eval_heuristic(board, parameters, bbox, ctx);
-    int K = (depth >= 2 ? 24 : 16);
-    best_move tk;
-    generate_candidates(board, parameters, bbox, isMax, K, &tk, ctx);
-    if (tk.n == 0) return 0;
-    char me = isMax ? parameters->ai : parameters->player;
-    for (int i = 0; i < tk.n; ++i) {
-        long long x = tk.x[i], y = tk.y[i];
-        insert(board, x, y, me);
-        bool win = check_win(board, parameters->size, parameters->len, x, y, me, ctx);
-        remove_cell(board, x, y);
-        if (win) {
-            if (isMax) return 100000 - (int)parameters->count_moves;
-            else return -100000 + (int)parameters->count_moves;
+    case NODE_REDUCED:
+        //  :     ,     
+        if (f->isMax ? cs->ret > f->alpha : cs->ret < f->beta) coop_child_full(cs, f);
+        else coop_child_done(cs, f, cs->ret);
+        return;
+    case NODE_NULL_WINDOW:
+        if (cs->ret > f->alpha && cs->ret < f->beta) {
+            f->stage = NODE_CHILD;
+            coop_call(cs, !f->isMax, f->alpha, f->beta, f->depth - 1);
+        }
+        else coop_child_done(cs, f, cs->ret);
+        return;
+    case NODE_CHILD:
+        coop_child_done(cs, f, cs->ret);
+        return;
+    case NODE_LEAF:
+        coop_return(cs, cs->ret);
+        return;
+    case QUIET_ENTER: {
+        quiesce_kind kind = quiesce_enter(ctx, f->isMax, &f->alpha, &f->beta, f->depth, &f->best, &f->moves);
+        if (kind == QUIESCE_DONE) {
+            coop_return(cs, f->best);
+            return;
+        }
+        f->i = 0;
+        f->stage = kind == QUIESCE_BLOCK ? QUIET_BLOCK : QUIET_NEXT;
+        if (kind == QUIESCE_BLOCK) {
+            make_move(ctx, best_move_x(&f->moves)[0], best_move_y(&f->moves)[0], f->isMax ? p->ai : p->player);
+            coop_quiet_call(cs, !f->isMax, f->alpha, f->beta, f->depth - 1);
         }
+        return;
     }
-    if (isMax) {
-        int best = INT_MIN;
-        for (int i = 0; i < tk.n && best < beta; ++i) {
-            long long x = tk.x[i], y = tk.y[i];
-            insert(board, x, y, parameters->ai);
-            bbox_on_place(bbox, x, y);
-            long long saved_ai_x = parameters->last_ai_x, saved_ai_y = parameters->last_ai_y;
-            long long saved_pl_x = parameters->last_pl_x, saved_pl_y = parameters->last_pl_y;
-            parameters->last_ai_x = x;
-            parameters->last_ai_y = y;
-            parameters->count_moves++;
-            int val = minimax(board, parameters, bbox, false, alpha, beta, depth - 1, ctx);
-            remove_cell(board, x, y);
-            bbox_on_remove(bbox, board, parameters->size);
-            parameters->last_ai_x = saved_ai_x;
-            parameters->last_ai_y = saved_ai_y;
-            parameters->last_pl_x = saved_pl_x;
-            parameters->last_pl_y = saved_pl_y;
-            parameters->count_moves--;
-            if (val > best) best = val;
-            if (best > alpha) alpha = best;
-            if (alpha >= beta) break;
-        }
-        return best;
+    case QUIET_BLOCK:
+        unmake_move(ctx);
+        coop_return(cs, cs->ret);
+        return;
+    case QUIET_NEXT:
+        if (f->i >= f->moves.n) {
+            coop_return(cs, f->best);
+            return;
+        }
+        make_move(ctx, best_move_x(&f->moves)[f->i], best_move_y(&f->moves)[f->i], f->isMax ? p->ai : p->player);
+        f->stage = QUIET_CHILD;
+        coop_quiet_call(cs, !f->isMax, f->alpha, f->beta, f->depth - 1);
+        return;
+    case QUIET_CHILD:
+        unmake_move(ctx);
+        if (quiesce_update(f->isMax, &f->alpha, &f->beta, &f->best, cs->ret)) f->i = f->moves.n;
+        else f->i++;
+        f->stage = QUIET_NEXT;
+        return;
     }
-    else {
-        int best = INT_MAX;
-        for (int i = 0; i < tk.n && best > alpha; ++i) {
-            long long x = tk.x[i], y = tk.y[i];
-            insert(board, x, y, parameters->player);
-            bbox_on_place(bbox, x, y);
-            long long saved_ai_x = parameters->last_ai_x, saved_ai_y = parameters->last_ai_y;
-            long long saved_pl_x = parameters->last_pl_x, saved_pl_y = parameters->last_pl_y;
-            parameters->last_pl_x = x;
-            parameters->last_pl_y = y;
-            parameters->count_moves++;
-            int val = minimax(board, parameters, bbox, true, alpha, beta, depth - 1, ctx);
-            remove_cell(board, x, y);
-            bbox_on_remove(bbox, board, parameters->size);
-            parameters->last_ai_x = saved_ai_x;
-            parameters->last_ai_y = saved_ai_y;
-            parameters->last_pl_x = saved_pl_x;
-            parameters->last_pl_y = saved_pl_y;
-            parameters->count_moves--;
-            if (val < best) best = val;
-            if (best < beta) beta = best;
-            if (alpha >= beta) break;
-        }
-        return best;
-    }
-}
-
-void minimax_move(Table* board, base* parameters, bounds* bbox, GameContext* ctx) {
-    long long bx, by;
-    if (find_immediate_move(board, parameters, bbox, true, &bx, &by, ctx)) {
-        insert(board, bx, by, parameters->ai);
-        bbox_on_place(bbox, bx, by);
-        parameters->last_ai_x = bx;
-        parameters->last_ai_y = by;
+}
+
+//     move      d   (alpha, beta)
+void coop_root_call(CoopSearch* cs, int move, int alpha, int beta) {
+    root_enter(&cs->engine, &cs->job, move);
+    coop_call(cs, false, alpha, beta, (short)cs->d);
+}
+
+//   :  ,     ,   minimax_move  root_work
+void coop_root_step(CoopSearch* cs) {
+    GameContext* ctx = &cs->engine;
+    RootState* rs = &cs->root;
+    RootJob* job = &cs->job;
+    switch (cs->stage) {
+    case ROOT_PREPARE: {
+        prep_stage prep = root_prepare_step(ctx, rs, cs->until);
+        if (prep == PREP_MOVED) cs->stage = ROOT_DONE;
+        else if (prep == PREP_READY) {
+            root_prepare_finish(ctx, rs, false);
+            cs->stage = ROOT_ITERATION;
+        }
         return;
     }
-    if (find_immediate_move(board, parameters, bbox, false, &bx, &by, ctx)) {
-        insert(board, bx, by, parameters->ai);
-        bbox_on_place(bbox, bx, by);
-        parameters->last_ai_x = bx;
-        parameters->last_ai_y = by;
+    case ROOT_ITERATION:
+        if (cs->d > rs->depth) {
+            root_finish(ctx, rs);
+            cs->stage = ROOT_DONE;
+            return;
+        }
+        root_window(rs, &cs->lo, &cs->hi);
+        cs->stage = ROOT_ATTEMPT;
+        return;
+    case ROOT_ATTEMPT: {
+        root_order(rs);
+        root_begin(job, &rs->moves, root_slots(rs), ctx->tt, (short)cs->d, cs->lo, cs->hi, rs->pvs);
+        if (rs->moves.n == 0) {
+            root_finish(ctx, rs);
+            cs->stage = ROOT_DONE;
+            return;
+        }
+        cs->stage = ROOT_FIRST;
+        coop_root_call(cs, 0, rs->pvs ? cs->lo : INT_MIN, rs->pvs ? cs->hi : INT_MAX);
         return;
     }
-
-    if (parameters->len == 3 && parameters->size > 4 && parameters->difficulty > 2) {
-        if (find_adjacent_move(board, parameters, bbox, &bx, &by, ctx)) {
-            insert(board, bx, by, parameters->ai);
-            bbox_on_place(bbox, bx, by);
-            parameters->last_ai_x = bx;
-            parameters->last_ai_y = by;
+    case ROOT_FIRST:
+        root_leave(ctx, job);
+        root_first(job, cs->ret);
+        cs->stage = ROOT_NEXT;
+        if (ctx->search_abort || job->cut) break;
+        return;
+    case ROOT_NEXT:
+        cs->move = root_take(job, &cs->move_alpha);
+        if (cs->move < 0) break;
+        if (!rs->pvs) {
+            cs->stage = ROOT_MOVE;
+            coop_root_call(cs, cs->move, cs->move_alpha, job->hi);
+        }
+        else {
+            cs->stage = ROOT_CHECK;
+            coop_root_call(cs, cs->move, cs->move_alpha, cs->move_alpha + 1);
+        }
+        return;
+    case ROOT_CHECK:
+        if (cs->ret > cs->move_alpha && cs->ret < job->hi) {
+            cs->stage = ROOT_MOVE;
+            coop_call(cs, false, cs->move_alpha, job->hi, (short)cs->d);
             return;
         }
+        // fall through
+    case ROOT_MOVE:
+        root_leave(ctx, job);
+        if (ctx->search_abort) break;
+        root_merge(job, cs->move, cs->ret);
+        cs->stage = ROOT_NEXT;
+        return;
+    case ROOT_DONE:
+        return;
     }
 
-    int bestVal = INT_MIN;
-    long long bestX = -1, bestY = -1;
-    best_move tk;
-    generate_candidates(board, parameters, bbox, true, 32, &tk, ctx);
-    int depth = 2;
-    if (ctx->parameters.difficulty == 4) depth = 5;
-    if (ctx->parameters.difficulty == 3) depth = 4;
-    if (ctx->parameters.difficulty == 2) depth = 3;
-
-    if (parameters->infinite_field == 0 && parameters->size == 3) depth += 2;
-    else if (parameters->infinite_field == 0 && parameters->size == 4) depth++;
+    //   :  ,       
+    if (ctx->search_abort) {
+        root_finish(ctx, rs);
+        cs->stage = ROOT_DONE;
+        return;
+    }
+    if (root_window_failed(job)) {
+        cs->lo = INT_MIN;
+        cs->hi = INT_MAX;
+        cs->stage = ROOT_ATTEMPT;
+        return;
+    }
+    if (root_iteration_done(ctx, rs, job, cs->d)) {
+        root_finish(ctx, rs);
+        cs->stage = ROOT_DONE;
+        return;
+    }
+    cs->d++;
+    cs->stage = ROOT_ITERATION;
+}
 
-    for (int i = 0; i < tk.n; ++i) {
-        long long x = tk.x[i], y = tk.y[i];
-        insert(board, x, y, parameters->ai);
-        bbox_on_place(bbox, x, y);
-        long long saved_ai_x = parameters->last_ai_x, saved_ai_y = parameters->last_ai_y;
-        long long saved_pl_x = parameters->last_pl_x, saved_pl_y = parameters->last_pl_y;
-        parameters->last_ai_x = x;
-        parameters->last_ai_y = y;
-        parameters->count_moves++;
-        int val = minimax(board, parameters, bbox, false, INT_MIN, INT_MAX, depth, ctx);
-        remove_cell(board, x, y);
-        bbox_on_remove(bbox, board, parameters->size);
-        parameters->last_ai_x = saved_ai_x;
-        parameters->last_ai_y = saved_ai_y;
-        parameters->last_pl_x = saved_pl_x;
-        parameters->last_pl_y = saved_pl_y;
-        parameters->count_moves--;
-        if (val > bestVal) {
-            bestVal = val;
-            bestX = x;
-            bestY = y;
-        }
-    }
-    if (bestX != -1) {
-        insert(board, bestX, bestY, parameters->ai);
-        bbox_on_place(bbox, bestX, bestY);
-        parameters->last_ai_x = bestX;
-        parameters->last_ai_y = bestY;
+//     slice_ms; true,       
+bool coop_run(CoopSearch* cs, unsigned int slice_ms) {
+    cs->until = now_ms() + slice_ms;
+    for (int n = 1; cs->stage != ROOT_DONE; ++n) {
+        if (cs->top > 0) coop_node_step(cs);
+        else coop_root_step(cs);
+        //       ,     
+        if ((cs->stage == ROOT_PREPARE || (n & 63) == 0) && now_ms() >= cs->until) break;
     }
+    return cs->stage == ROOT_DONE;
 }
 
 
@@ -790,7 +3679,7 @@ bool find_move_near_player(GameContext* ctx, long long* bx, long long* by) {
             }
         }
     }
-    long long bestRow = -1, bestCol = -1;
+    long long bestRow = 0, bestCol = 0;
     int maxPlayerNeighbors = 0;
 
     for (long long i = ctx->bbox.minx - 2; i <= ctx->bbox.maxx + 2; i++) {
@@ -825,7 +3714,7 @@ bool find_move_near_player(GameContext* ctx, long long* bx, long long* by) {
         }
     }
 
-    if (maxPlayerNeighbors >= 1 && bestRow != -1) {
+    if (maxPlayerNeighbors >= 1) {
         *bx = bestRow;
         *by = bestCol;
         return true;
@@ -934,8 +3823,11 @@ int evaluate_blocking_move(GameContext* ctx, long long row, long long col) {
         score += (ctx->parameters.size - distanceFromCenter) * 2;
     }
     else if (ctx->parameters.infinite_field == 1) {
-        long long distanceFromOrigin = llabs(row) + llabs(col);
-        score -= distanceFromOrigin * 2; 
+        //     ,    (0, 0):       
+        long long cx = ctx->bbox.minx + (ctx->bbox.maxx - ctx->bbox.minx) / 2;
+        long long cy = ctx->bbox.miny + (ctx->bbox.maxy - ctx->bbox.miny) / 2;
+        long long distanceFromCenter = llabs(row - cx) + llabs(col - cy);
+        score -= (int)distanceFromCenter * 2;
     }
 
     return score;
@@ -950,8 +3842,9 @@ bool find_best_blocking_position(GameContext* ctx, long long* bx, long long* by)
         return true;
     }
 
-    long long bestRow = -1, bestCol = -1;
+    long long bestRow = 0, bestCol = 0;
     int bestScore = INT_MIN;
+    bool found = false;
 
     for (long long i = ctx->bbox.minx - 2; i <= ctx->bbox.maxx + 2; i++) {
         for (long long j = ctx->bbox.miny - 2; j <= ctx->bbox.maxy + 2; j++) {
@@ -973,15 +3866,16 @@ bool find_best_blocking_position(GameContext* ctx, long long* bx, long long* by)
                 score += (ctx->parameters.size - distance);
             }
 
-            if (score > bestScore) {
+            if (!found || score > bestScore) {
                 bestScore = score;
                 bestRow = i;
                 bestCol = j;
+                found = true;
             }
         }
     }
 
-    if (bestRow != -1 && bestCol != -1) {
+    if (found) {
         *bx = bestRow;
         *by = bestCol;
         return true;
@@ -991,31 +3885,23 @@ bool find_best_blocking_position(GameContext* ctx, long long* bx, long long* by)
 }
 
 //   
-void new_computer_move(GameContext* ctx) {
+//     ; false,        
+bool rule_computer_move(GameContext* ctx) {
     long long bx, by;
 
     if (find_critical_threat(ctx, &bx, &by)) {
-        insert(ctx->board, bx, by, ctx->parameters.ai);
-        bbox_on_place(&ctx->bbox, bx, by);
-        ctx->parameters.last_ai_x = bx;
-        ctx->parameters.last_ai_y = by;
-        return;
+        play_move(ctx, bx, by, ctx->parameters.ai);
+        return true;
     }
 
     if (find_and_block_sequences(ctx, &bx, &by)) {
-        insert(ctx->board, bx, by, ctx->parameters.ai);
-        bbox_on_place(&ctx->bbox, bx, by);
-        ctx->parameters.last_ai_x = bx;
-        ctx->parameters.last_ai_y = by;
-        return;
+        play_move(ctx, bx, by, ctx->parameters.ai);
+        return true;
     }
 
     if (find_move_near_player(ctx, &bx, &by)) {
-        insert(ctx->board, bx, by, ctx->parameters.ai);
-        bbox_on_place(&ctx->bbox, bx, by);
-        ctx->parameters.last_ai_x = bx;
-        ctx->parameters.last_ai_y = by;
-        return;
+        play_move(ctx, bx, by, ctx->parameters.ai);
+        return true;
     }
 
     if (ctx->parameters.difficulty == 3) {
@@ -1024,7 +3910,12 @@ void new_computer_move(GameContext* ctx) {
     if (ctx->parameters.difficulty == 4) {
         ctx->parameters.depth = 10;
     }
-    minimax_move(ctx->board, &ctx->parameters, &ctx->bbox, ctx);
+    return false;
+}
+
+void new_computer_move(GameContext* ctx) {
+    if (rule_computer_move(ctx)) return;
+    minimax_move(ctx);
 }
 
 void easy_move(Table* board, base* parameters, bounds* bbox, GameContext* ctx) {
@@ -1034,13 +3925,10 @@ void easy_move(Table* board, base* parameters, bounds* bbox, GameContext* ctx) {
     if (cand.n > 0) {
         //    
         int random_index = rand() % cand.n;
-        long long x = cand.x[random_index];
-        long long y = cand.y[random_index];
+        long long x = best_move_x(&cand)[random_index];
+        long long y = best_move_y(&cand)[random_index];
 
-        insert(board, x, y, parameters->ai);
-        bbox_on_place(bbox, x, y);
-        parameters->last_ai_x = x;
-        parameters->last_ai_y = y;
+        play_move(ctx, x, y, parameters->ai);
     }
 }
 
@@ -1051,88 +3939,147 @@ void medium_move(Table* board, base* parameters, bounds* bbox, GameContext* ctx)
     //  
     if (find_immediate_move(board, parameters, bbox, true, &bx, &by, ctx) ||
         find_immediate_move(board, parameters, bbox, false, &bx, &by, ctx)) {
-        insert(board, bx, by, parameters->ai);
-        bbox_on_place(bbox, bx, by);
-        parameters->last_ai_x = bx;
-        parameters->last_ai_y = by;
+        play_move(ctx, bx, by, parameters->ai);
         return;
     }
     best_move cand;
     generate_candidates(board, parameters, bbox, true, 16, &cand, ctx); 
 
     if (cand.n > 0) {
-        insert(board, cand.x[0], cand.y[0], parameters->ai);
-        bbox_on_place(bbox, cand.x[0], cand.y[0]);
-        parameters->last_ai_x = cand.x[0];
-        parameters->last_ai_y = cand.y[0];
+        play_move(ctx, best_move_x(&cand)[0], best_move_y(&cand)[0], parameters->ai);
     }
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 // Save and load game
+//  save.dat:        
+#define SAVE_MAGIC 0x4B4D4F47u // "GOMK"
+#define SAVE_VERSION 2
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int game_size, bounds_size, node_size; //  ,     
+} SaveHeader;
+
+//  ,    ;    
+typedef struct {
+    unsigned long long size;
+    unsigned long long len;
+    unsigned long long count_moves;
+    long long last_ai_x, last_ai_y;
+    long long last_pl_x, last_pl_y;
+    short depth;
+    char player;
+    char ai;
+    short difficulty;
+    bool player_moves_first;
+    int infinite_field;
+} SavedGame;
+
+static SaveHeader save_header(void) {
+    SaveHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SAVE_MAGIC;
+    h.version = SAVE_VERSION;
+    h.game_size = sizeof(SavedGame);
+    h.bounds_size = sizeof(bounds);
+    h.node_size = sizeof(Node);
+    return h;
+}
+
 void save_game(GameContext* ctx) {
     FILE* file = fopen("save.dat", "wb");
     if (file) {
-        //    
-        fwrite(&ctx->parameters, sizeof(base), 1, file);
+        SaveHeader h = save_header();
+        fwrite(&h, sizeof(h), 1, file);
+
+        //     
+        base* p = &ctx->parameters;
+        SavedGame g;
+        memset(&g, 0, sizeof(g));
+        g.size = p->size;
+        g.len = p->len;
+        g.count_moves = p->count_moves;
+        g.last_ai_x = p->last_ai_x;
+        g.last_ai_y = p->last_ai_y;
+        g.last_pl_x = p->last_pl_x;
+        g.last_pl_y = p->last_pl_y;
+        g.depth = p->depth;
+        g.player = p->player;
+        g.ai = p->ai;
+        g.difficulty = p->difficulty;
+        g.player_moves_first = p->player_moves_first;
+        g.infinite_field = p->infinite_field;
+        fwrite(&g, sizeof(g), 1, file);
         fwrite(&ctx->bbox, sizeof(bounds), 1, file);
 
-        //   
-        fwrite(&ctx->parameters.count_moves, sizeof(unsigned long long), 1, file);
-
         //   
-        for (unsigned long long i = 0; i < ctx->board->capacity; i++) {
-            Node* current = ctx->board->buckets[i];
-            while (current) {
-                fwrite(current, sizeof(Node), 1, file);
-                current = current->next;
-            }
+        Node node;
+        unsigned long long it = 0;
+        while (table_next(ctx->board, &it, &node)) {
+            fwrite(&node, sizeof(Node), 1, file);
         }
         fclose(file);
     }
 }
 
+void search_cancel(GameContext* ctx);
+
 bool load_game(GameContext* ctx) {
+    //      
+    search_cancel(ctx);
     FILE* file = fopen("save.dat", "rb");
     if (file) {
-        //   
-        for (unsigned long long i = 0; i < ctx->board->capacity; i++) {
-            Node* current = ctx->board->buckets[i];
-            while (current) {
-                Node* temp = current;
-                current = current->next;
-                free(temp);
-            }
-            ctx->board->buckets[i] = NULL;
-        }
-
-        //    
-        if (fread(&ctx->parameters, sizeof(base), 1, file) != 1) {
+        //       ,    
+        SaveHeader want = save_header(), h;
+        SavedGame g;
+        bounds bbox;
+        if (fread(&h, sizeof(h), 1, file) != 1 || memcmp(&h, &want, sizeof(h)) != 0) {
+            printf("save.dat: unsupported save format\n");
             fclose(file);
             return false;
         }
-        if (fread(&ctx->bbox, sizeof(bounds), 1, file) != 1) {
+        if (fread(&g, sizeof(g), 1, file) != 1 || fread(&bbox, sizeof(bounds), 1, file) != 1) {
             fclose(file);
             return false;
         }
 
-        //   
-        unsigned long long count_moves;
-        if (fread(&count_moves, sizeof(unsigned long long), 1, file) != 1) {
-            fclose(file);
-            return false;
-        }
-        ctx->parameters.count_moves = count_moves;
+        //    ,    
+        base* p = &ctx->parameters;
+        p->size = g.size;
+        p->len = g.len;
+        p->count_moves = g.count_moves;
+        p->last_ai_x = g.last_ai_x;
+        p->last_ai_y = g.last_ai_y;
+        p->last_pl_x = g.last_pl_x;
+        p->last_pl_y = g.last_pl_y;
+        p->depth = g.depth;
+        p->player = g.player;
+        p->ai = g.ai;
+        p->difficulty = g.difficulty;
+        p->player_moves_first = g.player_moves_first;
+        p->infinite_field = g.infinite_field;
+        ctx->bbox = bbox;
+
+        //   
+        clear_table(ctx->board);
+        setup_table(ctx->board, p);
+        ctx->tt = reset_tt(ctx->tt, p->tt_mb);
+        threat_cache_clear(ctx);
 
         //  
         Node node;
         while (fread(&node, sizeof(Node), 1, file) == 1) {
             insert(ctx->board, node.x, node.y, node.value);
         }
+        threat_rebuild(ctx);
+        setup_patterns(ctx);
+        cand_rebuild(ctx);
 
         fclose(file);
-        ctx->is_player_turn = ctx->parameters.player_moves_first;
+        ctx->is_player_turn = p->player_moves_first;
         return true;
     }
     return false;
@@ -1519,12 +4466,12 @@ void drawgrid(GameContext* ctx) {
     glColor3f(0.0f, 0.1f, 0.1f);
     glLineWidth(1.0f);
 
-    long long start_x = floor((float)ctx->view_offset_x / CELL_SIZE);
-    long long start_y = floor((float)ctx->view_offset_y / CELL_SIZE);
+    long long start_x = ctx->view_offset_x;
+    long long start_y = ctx->view_offset_y;
 
     //       
     for (long long x = start_x; x <= start_x + VISIBLE_CELLS_X + 1; x++) {
-        float screen_x = x * CELL_SIZE - ctx->view_offset_x;
+        float screen_x = (float)((x - start_x) * CELL_SIZE);
         glBegin(GL_LINES);
         glVertex2f(screen_x, 0);
         glVertex2f(screen_x, VISIBLE_CELLS_Y * CELL_SIZE);
@@ -1532,7 +4479,7 @@ void drawgrid(GameContext* ctx) {
     }
 
     for (long long y = start_y; y <= start_y + VISIBLE_CELLS_Y + 1; y++) {
-        float screen_y = y * CELL_SIZE - ctx->view_offset_y;
+        float screen_y = (float)((y - start_y) * CELL_SIZE);
         glBegin(GL_LINES);
         glVertex2f(0, screen_y);
         glVertex2f(VISIBLE_CELLS_X * CELL_SIZE, screen_y);
@@ -1542,8 +4489,8 @@ void drawgrid(GameContext* ctx) {
     //       
     for (long long x = start_x; x < start_x + VISIBLE_CELLS_X; x++) {
         for (long long y = start_y; y < start_y + VISIBLE_CELLS_Y; y++) {
-            float screen_x = x * CELL_SIZE - ctx->view_offset_x;
-            float screen_y = y * CELL_SIZE - ctx->view_offset_y;
+            float screen_x = (float)((x - start_x) * CELL_SIZE);
+            float screen_y = (float)((y - start_y) * CELL_SIZE);
 
             char state = get_value(ctx->board, x, y, ctx->parameters.size, ctx);
 
@@ -1563,8 +4510,8 @@ void drawgrid(GameContext* ctx) {
     }
 
     //  (  )
-    float cursor_x = ctx->cursor_x * CELL_SIZE - ctx->view_offset_x;
-    float cursor_y = ctx->cursor_y * CELL_SIZE - ctx->view_offset_y;
+    float cursor_x = (float)((ctx->cursor_x - start_x) * CELL_SIZE);
+    float cursor_y = (float)((ctx->cursor_y - start_y) * CELL_SIZE);
     glColor3f(1.0f, 0.0f, 1.0f);
     glLineWidth(3.0f);
     glBegin(GL_LINE_LOOP);
@@ -1797,17 +4744,15 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
             }
             else {
                 //  
+                search_cancel(ctx);
                 ctx->current_screen = GAME_SCREEN;
-                for (unsigned long long i = 0; i < ctx->board->capacity; i++) {
-                    Node* current = ctx->board->buckets[i];
-                    while (current) {
-                        Node* temp = current;
-                        current = current->next;
-                        free(temp);
-                    }
-                    ctx->board->buckets[i] = NULL;
-                }
+                setup_table(ctx->board, &ctx->parameters);
+                ctx->tt = reset_tt(ctx->tt, ctx->parameters.tt_mb);
+                threat_cache_clear(ctx);
                 ctx->parameters.count_moves = 0;
+                threat_rebuild(ctx);
+                setup_patterns(ctx);
+                cand_rebuild(ctx);
                 ctx->bbox.initialized = false;
                 ctx->cursor_x = ctx->cursor_y = 0;
                 ctx->view_offset_x = ctx->view_offset_y = 0;
@@ -1845,7 +4790,7 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
             ctx->current_screen = MENU_SCREEN;
         }
         else if (mouse_over_button(ctx->size_up_button, xpos, ypos) && 0 == ctx->parameters.infinite_field) {
-            ctx->parameters.size++;
+            if (ctx->parameters.size < MAX_SIZE) ctx->parameters.size++;
         }
         else if (mouse_over_button(ctx->size_down_button, xpos, ypos) && 0 == ctx->parameters.infinite_field) {
             if (ctx->parameters.size > MIN_SIZE) ctx->parameters.size--;
@@ -1943,36 +4888,32 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     if (ctx->current_screen == GAME_SCREEN && action == GLFW_PRESS) {
         switch (key) {
         case GLFW_KEY_UP:
-            ctx->cursor_y--;
-            if (ctx->cursor_y * CELL_SIZE - ctx->view_offset_y < 0) {
-                ctx->view_offset_y = ctx->cursor_y * CELL_SIZE;
+            if (ctx->cursor_y > -COORD_LIMIT) ctx->cursor_y--;
+            if (ctx->cursor_y < ctx->view_offset_y) {
+                ctx->view_offset_y = ctx->cursor_y;
             }
             break;
         case GLFW_KEY_DOWN:
-            ctx->cursor_y++;
-            if (ctx->cursor_y * CELL_SIZE - ctx->view_offset_y > (VISIBLE_CELLS_Y - 1) * CELL_SIZE) {
-                ctx->view_offset_y = ctx->cursor_y * CELL_SIZE - (VISIBLE_CELLS_Y - 1) * CELL_SIZE;
+            if (ctx->cursor_y < COORD_LIMIT) ctx->cursor_y++;
+            if (ctx->cursor_y - ctx->view_offset_y > VISIBLE_CELLS_Y - 1) {
+                ctx->view_offset_y = ctx->cursor_y - (VISIBLE_CELLS_Y - 1);
             }
             break;
         case GLFW_KEY_LEFT:
-            ctx->cursor_x--;
-            if (ctx->cursor_x * CELL_SIZE - ctx->view_offset_x < 0) {
-                ctx->view_offset_x = ctx->cursor_x * CELL_SIZE;
+            if (ctx->cursor_x > -COORD_LIMIT) ctx->cursor_x--;
+            if (ctx->cursor_x < ctx->view_offset_x) {
+                ctx->view_offset_x = ctx->cursor_x;
             }
             break;
         case GLFW_KEY_RIGHT:
-            ctx->cursor_x++;
-            if (ctx->cursor_x * CELL_SIZE - ctx->view_offset_x > (VISIBLE_CELLS_X - 1) * CELL_SIZE) {
-                ctx->view_offset_x = ctx->cursor_x * CELL_SIZE - (VISIBLE_CELLS_X - 1) * CELL_SIZE;
+            if (ctx->cursor_x < COORD_LIMIT) ctx->cursor_x++;
+            if (ctx->cursor_x - ctx->view_offset_x > VISIBLE_CELLS_X - 1) {
+                ctx->view_offset_x = ctx->cursor_x - (VISIBLE_CELLS_X - 1);
             }
             break;
         case GLFW_KEY_SPACE:
             if (ctx->is_player_turn && get_value(ctx->board, ctx->cursor_x, ctx->cursor_y, ctx->parameters.size, ctx) == '.') {
-                insert(ctx->board, ctx->cursor_x, ctx->cursor_y, ctx->parameters.player);
-                bbox_on_place(&ctx->bbox, ctx->cursor_x, ctx->cursor_y);
-                ctx->parameters.last_pl_x = ctx->cursor_x;
-                ctx->parameters.last_pl_y = ctx->cursor_y;
-                ctx->parameters.count_moves++;
+                play_move(ctx, ctx->cursor_x, ctx->cursor_y, ctx->parameters.player);
 
                 if (check_win(ctx->board, ctx->parameters.size, ctx->parameters.len, ctx->cursor_x, ctx->cursor_y, ctx->parameters.player, ctx)) {
                     ctx->winner = 1;
@@ -2018,17 +4959,15 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             break;
         case GLFW_KEY_N:
             //  
+            search_cancel(ctx);
             ctx->current_screen = GAME_SCREEN;
-            for (unsigned long long i = 0; i < ctx->board->capacity; i++) {
-                Node* current = ctx->board->buckets[i];
-                while (current) {
-                    Node* temp = current;
-                    current = current->next;
-                    free(temp);
-                }
-                ctx->board->buckets[i] = NULL;
-            }
+            setup_table(ctx->board, &ctx->parameters);
+            ctx->tt = reset_tt(ctx->tt, ctx->parameters.tt_mb);
+            threat_cache_clear(ctx);
             ctx->parameters.count_moves = 0;
+            threat_rebuild(ctx);
+            setup_patterns(ctx);
+            cand_rebuild(ctx);
             ctx->bbox.initialized = false;
             ctx->cursor_x = ctx->cursor_y = 0;
             ctx->view_offset_x = ctx->view_offset_y = 0;
@@ -2124,23 +5063,24 @@ void draw_game_borders(GameContext* ctx) {
     glLineWidth(5.0f);
 
     //    
-    int start_x = floor((float)ctx->view_offset_x / CELL_SIZE);
-    int start_y = floor((float)ctx->view_offset_y / CELL_SIZE);
-    int end_x = start_x + VISIBLE_CELLS_X;
-    int end_y = start_y + VISIBLE_CELLS_Y;
+    long long start_x = ctx->view_offset_x;
+    long long start_y = ctx->view_offset_y;
+    long long end_x = start_x + VISIBLE_CELLS_X;
+    long long end_y = start_y + VISIBLE_CELLS_Y;
+    long long size = (long long)ctx->parameters.size;
 
     //     
-    end_x = (end_x > ctx->parameters.size) ? ctx->parameters.size : end_x;
-    end_y = (end_y > ctx->parameters.size) ? ctx->parameters.size : end_y;
+    end_x = (end_x > size) ? size : end_x;
+    end_y = (end_y > size) ? size : end_y;
     start_x = (start_x < 0) ? 0 : start_x;
     start_y = (start_y < 0) ? 0 : start_y;
 
     //      
     glBegin(GL_LINE_LOOP);
-    float x0 = start_x * CELL_SIZE - ctx->view_offset_x;
-    float y0 = start_y * CELL_SIZE - ctx->view_offset_y;
-    float x1 = end_x * CELL_SIZE - ctx->view_offset_x;
-    float y1 = end_y * CELL_SIZE - ctx->view_offset_y;
+    float x0 = (float)((start_x - ctx->view_offset_x) * CELL_SIZE);
+    float y0 = (float)((start_y - ctx->view_offset_y) * CELL_SIZE);
+    float x1 = (float)((end_x - ctx->view_offset_x) * CELL_SIZE);
+    float y1 = (float)((end_y - ctx->view_offset_y) * CELL_SIZE);
 
     glVertex2f(x0, y0);
     glVertex2f(x1, y0);
@@ -2152,6 +5092,20 @@ void draw_game_borders(GameContext* ctx) {
 }
 
 
+//  :    ,   ,   
+void draw_thinking(GameContext* ctx) {
+    float cx = WINDOW_WIDTH - 60, cy = 70;
+    float angle = (float)glfwGetTime() * 6.0f;
+    glColor3f(0.0f, 0.0f, 0.0f);
+    drawtext(ctx, "THINKING", WINDOW_WIDTH - 190, cy, 0.7f);
+    glLineWidth(3.0f);
+    glBegin(GL_LINES);
+    glVertex2f(cx - 15 * cosf(angle), cy - 15 * sinf(angle));
+    glVertex2f(cx + 15 * cosf(angle), cy + 15 * sinf(angle));
+    glEnd();
+    glLineWidth(1.0f);
+}
+
 void draw_game(GameContext* ctx) {
     glClear(GL_COLOR_BUFFER_BIT);
     glClearColor(0.9f, 0.9f, 0.9f, 1.0f); //     
@@ -2159,18 +5113,11 @@ void draw_game(GameContext* ctx) {
     drawgrid(ctx); //   
     drawbutton(ctx, ctx->back_button); //   "BACK"
     //   
+    if (!ctx->is_player_turn && ctx->winner == 0) draw_thinking(ctx);
 }
 
-void computer_move(GameContext* ctx) {
-    best_move cand;
-    generate_candidates(ctx->board, &ctx->parameters, &ctx->bbox, true, 64, &cand, ctx);
-
-    if (cand.n == 0) { // ,   
-        ctx->winner = 3;
-        ctx->current_screen = GAME_OVER;
-        return;
-    }
-
+//    ,    ctx
+void choose_ai_move(GameContext* ctx) {
     if (ctx->parameters.difficulty == 3 || ctx->parameters.difficulty == 4) {
         new_computer_move(ctx);
     }
@@ -2180,16 +5127,17 @@ void computer_move(GameContext* ctx) {
     else if (ctx->parameters.difficulty == 1) {
         easy_move(ctx->board, &ctx->parameters, &ctx->bbox, ctx);
     }
-    ctx->parameters.count_moves++;
+}
 
+//   : ,    
+void finish_ai_move(GameContext* ctx) {
     if (check_win(ctx->board, ctx->parameters.size, ctx->parameters.len,
         ctx->parameters.last_ai_x, ctx->parameters.last_ai_y, ctx->parameters.ai, ctx)) {
         ctx->winner = 2;
         ctx->current_screen = GAME_OVER;
     }
     else {
-        generate_candidates(ctx->board, &ctx->parameters, &ctx->bbox, false, 64, &cand, ctx);
-        if (cand.n == 0) { // ,   
+        if (no_moves_left(ctx)) { // ,   
             ctx->winner = 3;
             ctx->current_screen = GAME_OVER;
         }
@@ -2199,9 +5147,364 @@ void computer_move(GameContext* ctx) {
     }
 }
 
+//    ,   
+bool ai_draw(GameContext* ctx) {
+    if (!no_moves_left(ctx)) return false;
+    ctx->winner = 3;
+    ctx->current_screen = GAME_OVER;
+    return true;
+}
+
+/*       :  ,    
+ ,        :    
+     ,       (search_cancel)*/
+void engine_init(GameContext* e) {
+    memset(e, 0, sizeof(GameContext));
+    e->board = create_table(1024);
+    e->undo_capacity = 64;
+    e->undo = (UndoEntry*)malloc(e->undo_capacity * sizeof(UndoEntry));
+    if (!e->undo) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+    cand_init(&e->cands, 1024);
+}
+
+void engine_free(GameContext* e) {
+    free_table(e->board);
+    free(e->undo);
+    cand_free(&e->cands);
+#ifndef NO_THREADS
+    if (e->pool) free_pool(e->pool);
+#endif
+}
+
+//     
+void engine_sync(GameContext* e, GameContext* ctx) {
+    e->parameters = ctx->parameters;
+    e->bbox = ctx->bbox;
+    copy_table(e->board, ctx->board);
+    memcpy(e->threats, ctx->threats, sizeof(ctx->threats));
+    e->patterns = ctx->patterns;
+    e->pattern_len = ctx->pattern_len;
+    cand_rebuild(e);
+    e->undo_top = 0;
+    e->tt = ctx->tt;
+    e->threat_cache = ctx->threat_cache;
+    e->null_move = false;
+#ifndef NO_THREADS
+    e->split = NULL;
+#endif
+}
+
+#ifndef NO_THREADS
+//   :      ,        
+typedef struct AIWorker {
+    thrd_t thread;
+    mtx_t lock;
+    cnd_t wake, idle;
+    GameContext engine;
+    bool pending;       //   
+    bool busy;          //   
+    bool quit;
+    atomic_bool cancel; //    ,      
+    long long queue_x[AI_QUEUE_SIZE], queue_y[AI_QUEUE_SIZE]; // , LLONG_MAX -   
+    int head, count;
+    bool waiting;       //    :  ,    
+    bool pondering;     //    :       
+    long long ponder_x, ponder_y; //   
+} AIWorker;
+
+int ai_thread(void* arg) {
+    AIWorker* ai = (AIWorker*)arg;
+    GameContext* e = &ai->engine;
+    mtx_lock(&ai->lock);
+    for (;;) {
+        while (!ai->quit && !ai->pending) cnd_wait(&ai->wake, &ai->lock);
+        if (ai->quit) break;
+        ai->pending = false;
+        ai->busy = true;
+        mtx_unlock(&ai->lock);
+
+        unsigned long long before = e->parameters.count_moves;
+        choose_ai_move(e);
+        bool moved = e->parameters.count_moves > before;
+
+        mtx_lock(&ai->lock);
+        if (!atomic_load(&ai->cancel) && ai->count < AI_QUEUE_SIZE) {
+            int tail = (ai->head + ai->count++) % AI_QUEUE_SIZE;
+            ai->queue_x[tail] = moved ? e->parameters.last_ai_x : LLONG_MAX;
+            ai->queue_y[tail] = moved ? e->parameters.last_ai_y : LLONG_MAX;
+        }
+        ai->busy = false;
+        cnd_broadcast(&ai->idle);
+    }
+    mtx_unlock(&ai->lock);
+    return 0;
+}
+
+//    ; NULL,     
+AIWorker* ai_start(void) {
+    AIWorker* ai = (AIWorker*)calloc(1, sizeof(AIWorker));
+    if (!ai) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+    GameContext* e = &ai->engine;
+    engine_init(e);
+    e->stop = &ai->cancel;
+    mtx_init(&ai->lock, mtx_plain);
+    cnd_init(&ai->wake);
+    cnd_init(&ai->idle);
+    atomic_init(&ai->cancel, false);
+    if (thrd_create(&ai->thread, ai_thread, ai) != thrd_success) {
+        printf("AI thread creation error, using time-sliced search\n");
+        engine_free(e);
+        mtx_destroy(&ai->lock);
+        cnd_destroy(&ai->wake);
+        cnd_destroy(&ai->idle);
+        free(ai);
+        return NULL;
+    }
+    return ai;
+}
+
+void ai_free(AIWorker* ai) {
+    atomic_store(&ai->cancel, true);
+    mtx_lock(&ai->lock);
+    ai->quit = true;
+    cnd_signal(&ai->wake);
+    mtx_unlock(&ai->lock);
+    thrd_join(ai->thread, NULL);
+    engine_free(&ai->engine);
+    mtx_destroy(&ai->lock);
+    cnd_destroy(&ai->wake);
+    cnd_destroy(&ai->idle);
+    free(ai);
+}
+
+/*   ,      :    stop ,
+  ,   , -      */
+void ai_cancel(GameContext* ctx) {
+    AIWorker* ai = ctx->ai;
+    atomic_store(&ai->cancel, true);
+    mtx_lock(&ai->lock);
+    ai->pending = false;
+    while (ai->busy) cnd_wait(&ai->idle, &ai->lock);
+    ai->head = ai->count = 0;
+    mtx_unlock(&ai->lock);
+    ai->waiting = false;
+    ai->pondering = false;
+}
+
+
+//       
+void ai_wake(AIWorker* ai) {
+    atomic_store(&ai->cancel, false);
+    ai->pending = true;
+    cnd_signal(&ai->wake);
+}
+
+//  :    ,   
+void ai_request(GameContext* ctx) {
+    if (ai_draw(ctx)) return;
+    AIWorker* ai = ctx->ai;
+    mtx_lock(&ai->lock);
+    engine_sync(&ai->engine, ctx);
+    ai_wake(ai);
+    mtx_unlock(&ai->lock);
+    ai->waiting = true;
+}
+
+/*   :     -      -
+       ;     
+          */
+void ai_ponder(GameContext* ctx) {
+    AIWorker* ai = ctx->ai;
+    //       ,   
+    if (!ctx->parameters.ponder || ctx->parameters.difficulty < 3) return;
+    GameContext* e = &ai->engine;
+    mtx_lock(&ai->lock);
+    engine_sync(&ai->engine, ctx);
+    best_move reply;
+    generate_candidates(e->board, &e->parameters, &e->bbox, false, 1, &reply, e);
+    if (reply.n == 0) {
+        mtx_unlock(&ai->lock);
+        return;
+    }
+    ai->ponder_x = best_move_x(&reply)[0];
+    ai->ponder_y = best_move_y(&reply)[0];
+    play_move(e, ai->ponder_x, ai->ponder_y, e->parameters.player);
+    ai_wake(ai);
+    mtx_unlock(&ai->lock);
+    ai->pondering = true;
+    if (AI_DEBUG) printf("AI ponder: expecting (%lld, %lld)\n", ai->ponder_x, ai->ponder_y);
+}
+
+/*    :   ,        ,
+     ,      */
+void ai_ponder_resolve(GameContext* ctx) {
+    AIWorker* ai = ctx->ai;
+    ai->pondering = false;
+    if (ctx->parameters.last_pl_x == ai->ponder_x && ctx->parameters.last_pl_y == ai->ponder_y) {
+        if (AI_DEBUG) printf("AI ponder: hit\n");
+        ai->waiting = true;
+        return;
+    }
+    if (AI_DEBUG) printf("AI ponder: miss\n");
+    ai_cancel(ctx);
+    ai_request(ctx);
+}
+
+//  ,   :     
+void ai_poll(GameContext* ctx) {
+    AIWorker* ai = ctx->ai;
+    mtx_lock(&ai->lock);
+    if (ai->count == 0) {
+        mtx_unlock(&ai->lock);
+        return;
+    }
+    long long x = ai->queue_x[ai->head], y = ai->queue_y[ai->head];
+    ai->head = (ai->head + 1) % AI_QUEUE_SIZE;
+    ai->count--;
+    mtx_unlock(&ai->lock);
+    ai->waiting = false;
+    if (x != LLONG_MAX) play_move(ctx, x, y, ctx->parameters.ai);
+    finish_ai_move(ctx);
+    if (ctx->is_player_turn) ai_ponder(ctx);
+}
+#endif
+
+/*   :       ,  ,
+       
+      ,       */
+void coop_start(GameContext* ctx) {
+    if (ai_draw(ctx)) return;
+    CoopSearch* cs = (CoopSearch*)calloc(1, sizeof(CoopSearch));
+    if (!cs) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+    GameContext* e = &cs->engine;
+    engine_init(e);
+    engine_sync(e, ctx);
+    ctx->coop = cs;
+    cs->stage = ROOT_DONE;
+    if (e->parameters.difficulty < 3) choose_ai_move(e);
+    else if (!rule_computer_move(e) && !root_prepare_start(e, &cs->root)) cs->stage = ROOT_PREPARE;
+}
+
+void coop_cancel(GameContext* ctx) {
+    best_move_free(&ctx->coop->root.all); //     
+    engine_free(&ctx->coop->engine);
+    free(ctx->coop);
+    ctx->coop = NULL;
+}
+
+/*  ,     ,     
+  ,          */
+void search_cancel(GameContext* ctx) {
+#ifndef NO_THREADS
+    if (ctx->ai) ai_cancel(ctx);
+#endif
+    if (ctx->coop) coop_cancel(ctx);
+}
+
+//    ;   ,     
+void coop_poll(GameContext* ctx) {
+    CoopSearch* cs = ctx->coop;
+    if (!coop_run(cs, COOP_SLICE_MS)) return;
+    base* e = &cs->engine.parameters;
+    bool moved = e->count_moves > ctx->parameters.count_moves;
+    long long x = e->last_ai_x, y = e->last_ai_y;
+    coop_cancel(ctx);
+    if (moved) play_move(ctx, x, y, ctx->parameters.ai);
+    finish_ai_move(ctx);
+}
+
+//  /  engine.cfg: on/off, yes/no  1/0; false,    
+bool config_flag(const char* value, bool* flag) {
+    if (!strcmp(value, "on") || !strcmp(value, "yes") || !strcmp(value, "1")) *flag = true;
+    else if (!strcmp(value, "off") || !strcmp(value, "no") || !strcmp(value, "0")) *flag = false;
+    else return false;
+    return true;
+}
+
+//   engine.cfg   [lo, hi]; false,    
+bool config_int(const char* value, long lo, long hi, long* number) {
+    char* end;
+    long n = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || n < lo || n > hi) return false;
+    *number = n;
+    return true;
+}
+
+/*   engine.cfg   save.dat:  " = ",  # - 
+search = pvs | alphabeta, lmr = on | off, null_move = on | off, threads = 1..64,
+parallel = root | lazy | ybwc, tt_mb = 1..4096, time_ms = 0..600000 (0 -  ),
+ponder = on | off, cooperative = on | off
+  -    ,     */
+void load_engine_config(base* p) {
+    FILE* file = fopen("engine.cfg", "r");
+    if (!file) return;
+    char line[128];
+    int number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        number++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        char* eq = strchr(line, '=');
+        if (eq) *eq = ' ';
+        char name[32], value[32], extra[2];
+        int fields = sscanf(line, "%31s %31s %1s", name, value, extra);
+        if (fields <= 0) continue;
+        long n = 0;
+        bool ok = true;
+        if (fields != 2 || !eq) ok = false;
+        else if (!strcmp(name, "search")) {
+            if (!strcmp(value, "pvs")) p->search_mode = PVS;
+            else if (!strcmp(value, "alphabeta")) p->search_mode = MINIMAX;
+            else ok = false;
+        }
+        else if (!strcmp(name, "lmr")) ok = config_flag(value, &p->use_lmr);
+        else if (!strcmp(name, "null_move")) ok = config_flag(value, &p->use_null_move);
+        else if (!strcmp(name, "threads")) {
+            ok = config_int(value, 1, 64, &n);
+            if (ok) p->search_threads = (int)n;
+        }
+        else if (!strcmp(name, "parallel")) {
+            if (!strcmp(value, "root")) p->parallel_mode = ROOT_SPLIT;
+            else if (!strcmp(value, "lazy")) p->parallel_mode = LAZY_SMP;
+            else if (!strcmp(value, "ybwc")) p->parallel_mode = YBWC;
+            else ok = false;
+        }
+        else if (!strcmp(name, "tt_mb")) {
+            ok = config_int(value, 1, 4096, &n);
+            if (ok) p->tt_mb = (unsigned int)n;
+        }
+        else if (!strcmp(name, "time_ms")) {
+            ok = config_int(value, 0, 600000, &n);
+            if (ok) p->time_budget_ms = (unsigned int)n;
+        }
+        else if (!strcmp(name, "ponder")) ok = config_flag(value, &p->ponder);
+        else if (!strcmp(name, "cooperative")) ok = config_flag(value, &p->cooperative);
+        else ok = false;
+        if (!ok) printf("engine.cfg:%d: bad setting ignored\n", number);
+    }
+    fclose(file);
+}
+
 void init_game_context(GameContext* ctx) {
     ctx->current_screen = MENU_SCREEN;
     ctx->board = create_table(1024);
+    ctx->tt = NULL;
+    ctx->undo_capacity = 64;
+    ctx->undo_top = 0;
+    ctx->undo = (UndoEntry*)malloc(ctx->undo_capacity * sizeof(UndoEntry));
+    if (!ctx->undo) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
     ctx->parameters.size = 3;
     ctx->parameters.len = 3;
     ctx->parameters.count_moves = 0;
@@ -2213,6 +5516,44 @@ void init_game_context(GameContext* ctx) {
     ctx->parameters.difficulty = 1;
     ctx->parameters.player_moves_first = true;
     ctx->parameters.infinite_field = 0;
+    ctx->parameters.tt_mb = 16;
+    ctx->parameters.time_budget_ms = 1500;
+    ctx->parameters.search_mode = PVS;
+    ctx->parameters.use_lmr = true;
+    ctx->parameters.use_null_move = true;
+    ctx->parameters.search_threads = 4;
+    ctx->parameters.parallel_mode = ROOT_SPLIT;
+    ctx->parameters.ponder = true;
+    ctx->parameters.cooperative = false;
+    load_engine_config(&ctx->parameters);
+#ifdef NO_THREADS
+    ctx->parameters.cooperative = true; //     ,    
+#endif
+    ctx->tt = reset_tt(ctx->tt, ctx->parameters.tt_mb);
+    ctx->threat_cache = (ThreatEntry*)calloc(THREAT_CACHE_SIZE, sizeof(ThreatEntry));
+    if (!ctx->threat_cache) {
+        printf("Memory allocation error\n");
+        exit(1);
+    }
+    ctx->threat_nodes = 0;
+    memset(ctx->threats, 0, sizeof(ctx->threats));
+    ctx->patterns = NULL;
+    ctx->pattern_len = 0;
+    setup_patterns(ctx);
+    cand_init(&ctx->cands, 1024);
+    ctx->search_deadline = 0;
+    ctx->search_abort = false;
+    ctx->search_nodes = 0;
+    ctx->search_depth = 0;
+    ctx->null_move = false;
+#ifndef NO_THREADS
+    ctx->pool = NULL;
+    ctx->stop = NULL;
+    ctx->split = NULL;
+    ctx->slot = 0;
+    ctx->ai = ctx->parameters.cooperative ? NULL : ai_start();
+#endif
+    ctx->coop = NULL;
     ctx->bbox.initialized = false;
     ctx->char_width = 15.0f;
     ctx->char_height = 20.0f;
@@ -2252,6 +5593,7 @@ int main() {
     }
 
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(1); //    ,       
 
     //  GLEW   
     glewExperimental = GL_TRUE;
@@ -2280,8 +5622,28 @@ int main() {
 
         update_hover_state(window, &ctx);
 
+        /*    ,        
+                poll  swap
+        Esc, Back         */
         if (ctx.current_screen == GAME_SCREEN && !ctx.is_player_turn && ctx.winner == 0) {
-            computer_move(&ctx);
+#ifndef NO_THREADS
+            if (ctx.ai) {
+                if (ctx.ai->pondering) ai_ponder_resolve(&ctx);
+                else if (!ctx.ai->waiting) ai_request(&ctx);
+                else ai_poll(&ctx);
+            }
+            else
+#endif
+            {
+                if (!ctx.coop) coop_start(&ctx);
+                if (ctx.coop) coop_poll(&ctx);
+            }
+        }
+        else if (ctx.current_screen != GAME_SCREEN) {
+#ifndef NO_THREADS
+            if (ctx.ai && (ctx.ai->waiting || ctx.ai->pondering)) ai_cancel(&ctx);
+#endif
+            if (ctx.coop) coop_cancel(&ctx);
         }
 
         switch (ctx.current_screen) {
@@ -2297,16 +5659,19 @@ int main() {
         glfwPollEvents();
     }
 
-    for (unsigned long long i = 0; i < ctx.board->capacity; i++) {
-        Node* current = ctx.board->buckets[i];
-        while (current) {
-            Node* temp = current;
-            current = current->next;
-            free(temp);
-        }
-    }
-    free(ctx.board->buckets);
-    free(ctx.board);
+#ifndef NO_THREADS
+    if (ctx.ai) ai_free(ctx.ai); //   ,     
+#endif
+    if (ctx.coop) coop_cancel(&ctx);
+    free_table(ctx.board);
+    free_tt(ctx.tt);
+    free(ctx.undo);
+    free(ctx.patterns);
+    cand_free(&ctx.cands);
+    free(ctx.threat_cache);
+#ifndef NO_THREADS
+    if (ctx.pool) free_pool(ctx.pool);
+#endif
     glfwTerminate();
     return 0;
 }
\ No newline at end of file